@@ -0,0 +1,84 @@
+//--------------------------------------------------------------------------------------
+// File: Benchmarks.cpp
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//
+// https://go.microsoft.com/fwlink/?LinkID=615561
+//--------------------------------------------------------------------------------------
+
+#include "Benchmarks.h"
+
+#include <cstring>
+#include <exception>
+
+using namespace Benchmarks;
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    struct Benchmark
+    {
+        const char* name;
+        void (*run)(const Context&);
+    };
+
+    const Benchmark c_Benchmarks[] =
+    {
+        { "graphicsmemory", RunGraphicsMemoryBenchmarks },
+        { "replay", RunReplayBenchmarks },
+        { "retire", RunRetireBenchmarks },
+        { "spritebatch", RunSpriteBatchBenchmarks },
+        { "upload", RunUploadBenchmarks },
+    };
+
+    bool IsSelected(const char* name, int argc, char* argv[]) noexcept
+    {
+        if (argc < 2)
+            return true;
+
+        for (int j = 1; j < argc; ++j)
+        {
+            if (!strcmp(argv[j], name))
+                return true;
+        }
+
+        return false;
+    }
+}
+
+
+// Times the toolkit's CPU paths against the mock device. Pass benchmark names on the
+// command line to run a subset of them.
+int main(int argc, char* argv[])
+{
+    try
+    {
+        Context context;
+        ThrowIfFailed(MockD3D12::CreateDevice(context.device.GetAddressOf()));
+
+        D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+        queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+        ThrowIfFailed(context.device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(context.queue.GetAddressOf())));
+
+        for (const auto& benchmark : c_Benchmarks)
+        {
+            if (!IsSelected(benchmark.name, argc, argv))
+                continue;
+
+            printf("%s\n", benchmark.name);
+            benchmark.run(context);
+        }
+
+        const auto stats = MockD3D12::GetStatistics(context.device.Get());
+        printf("mock device: %zu resources (%zu bytes), %zu executions, %zu draws, %zu barriers, %zu copies (%zu bytes)\n",
+            stats.resources, stats.resourceBytes, stats.executions, stats.draws, stats.barriers, stats.copies, stats.bytesCopied);
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "ERROR: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
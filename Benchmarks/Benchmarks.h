@@ -0,0 +1,62 @@
+//--------------------------------------------------------------------------------------
+// File: Benchmarks.h
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//
+// https://go.microsoft.com/fwlink/?LinkID=615561
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "MockDevice.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <stdexcept>
+
+#include <wrl/client.h>
+
+
+namespace Benchmarks
+{
+    struct Context
+    {
+        Microsoft::WRL::ComPtr<ID3D12Device>        device;
+        Microsoft::WRL::ComPtr<ID3D12CommandQueue>  queue;
+    };
+
+    inline void ThrowIfFailed(HRESULT hr)
+    {
+        if (FAILED(hr))
+        {
+            char str[64] = {};
+            snprintf(str, sizeof(str), "Failure with HRESULT of %08X", static_cast<unsigned int>(hr));
+            throw std::runtime_error(str);
+        }
+    }
+
+    // Calls fn(iteration) the given number of times and prints the mean time per iteration
+    // in microseconds, which is also returned.
+    template<typename F>
+    double Measure(const char* name, size_t iterations, F&& fn)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t j = 0; j < iterations; ++j)
+        {
+            fn(j);
+        }
+        const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+        const double mean = elapsed.count() / double(iterations);
+        printf("  %-48s %12.3f us\n", name, mean);
+        return mean;
+    }
+
+    void RunGraphicsMemoryBenchmarks(const Context& context);
+    void RunReplayBenchmarks(const Context& context);
+    void RunRetireBenchmarks(const Context& context);
+    void RunSpriteBatchBenchmarks(const Context& context);
+    void RunUploadBenchmarks(const Context& context);
+}
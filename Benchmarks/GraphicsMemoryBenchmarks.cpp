@@ -0,0 +1,286 @@
+//--------------------------------------------------------------------------------------
+// File: GraphicsMemoryBenchmarks.cpp
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//
+// https://go.microsoft.com/fwlink/?LinkID=615561
+//--------------------------------------------------------------------------------------
+
+#include "Benchmarks.h"
+
+#include "GraphicsMemory.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+using namespace Benchmarks;
+using namespace DirectX;
+
+namespace
+{
+    constexpr size_t c_AllocationsPerThread = 4096;
+    constexpr size_t c_Frames = 50;
+    constexpr unsigned int c_MaxThreads = 16;
+
+    // Requests up to 16KB are served from pages reserved by the calling thread, while larger
+    // ones still go through the allocator's shared lock, so both sizes are timed
+    struct AllocationCase
+    {
+        const char* name;
+        size_t size;
+        size_t alignment;
+        uint32_t tag;
+    };
+
+    const AllocationCase c_Cases[] =
+    {
+        { "256B constants", 256, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, GraphicsMemory::TAG_CONSTANT },
+        { "32KB buffers", 32768, 16, GraphicsMemory::TAG_VERTEX },
+    };
+
+    // Each worker keeps its allocations alive until the end of the frame, as a command list
+    // recording thread would, then the frame is committed from the calling thread
+    double MeasureFrames(const char* name, GraphicsMemory& graphicsMemory, ID3D12CommandQueue* queue,
+        const AllocationCase& test, unsigned int threadCount)
+    {
+        std::vector<std::vector<GraphicsResource>> live(threadCount);
+        for (auto& allocations : live)
+        {
+            allocations.reserve(c_AllocationsPerThread);
+        }
+
+        return Measure(name, c_Frames, [&](size_t)
+            {
+                std::vector<std::thread> threads;
+                threads.reserve(threadCount);
+
+                for (unsigned int t = 0; t < threadCount; ++t)
+                {
+                    threads.emplace_back([&, t]()
+                        {
+                            auto& allocations = live[t];
+                            for (size_t j = 0; j < c_AllocationsPerThread; ++j)
+                            {
+                                allocations.emplace_back(graphicsMemory.Allocate(test.size, test.alignment, test.tag));
+                            }
+                        });
+                }
+
+                for (auto& thread : threads)
+                {
+                    thread.join();
+                }
+
+                for (auto& allocations : live)
+                {
+                    allocations.clear();
+                }
+
+                graphicsMemory.Commit(queue);
+            });
+    }
+
+    constexpr size_t c_TraceFrames = 30;
+    constexpr size_t c_ReplayIterations = 20;
+
+    struct ReplayCase
+    {
+        const char* name;
+        GRAPHICS_MEMORY_FLAGS flags;
+    };
+
+    const ReplayCase c_ReplayCases[] =
+    {
+        { "default", GRAPHICS_MEMORY_DEFAULT },
+        { "ring buffer", GRAPHICS_MEMORY_RING_BUFFER },
+        { "placed pages", GRAPHICS_MEMORY_PLACED_PAGES },
+        { "ring buffer and placed pages", GRAPHICS_MEMORY_RING_BUFFER | GRAPHICS_MEMORY_PLACED_PAGES },
+    };
+
+    // Records a fixed set of frames shaped like a typical scene: many small constant buffers,
+    // some dynamic vertex data of varying size, and a few texture uploads
+    std::vector<uint8_t> RecordTrace(ID3D12Device* device, ID3D12CommandQueue* queue)
+    {
+        GraphicsMemory graphicsMemory(device);
+        graphicsMemory.StartTrace();
+
+        uint32_t seed = 12345;
+        auto random = [&seed](uint32_t range) noexcept
+            {
+                seed = seed * 1664525u + 1013904223u;
+                return (seed >> 8) % range;
+            };
+
+        std::vector<GraphicsResource> frame;
+        for (size_t f = 0; f < c_TraceFrames; ++f)
+        {
+            for (size_t j = 0; j < 2000; ++j)
+            {
+                frame.emplace_back(graphicsMemory.Allocate(256u * (1u + random(4)),
+                    D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, GraphicsMemory::TAG_CONSTANT));
+            }
+
+            for (size_t j = 0; j < 200; ++j)
+            {
+                frame.emplace_back(graphicsMemory.Allocate(1024u + random(63 * 1024), 16, GraphicsMemory::TAG_VERTEX));
+            }
+
+            for (size_t j = 0; j < 8; ++j)
+            {
+                frame.emplace_back(graphicsMemory.Allocate(size_t(256 * 1024) << random(3),
+                    D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, GraphicsMemory::TAG_TEXTURE));
+            }
+
+            frame.clear();
+            graphicsMemory.Commit(queue);
+        }
+
+        return graphicsMemory.StopTrace();
+    }
+
+    constexpr size_t c_PagesPerFrame[] = { 16, 64, 256, 1024 };
+    constexpr size_t c_FramesInFlight[] = { 1, 2, 3 };
+    constexpr size_t c_RetireFrames = 100;
+
+    // Fills a whole 64KB page, so each allocation holds one page in flight
+    constexpr size_t c_PageAllocationSize = 64 * 1024 - 16;
+
+    // Completes every held signal before the GraphicsMemory waits on its fences at destruction
+    struct FrameLatencyScope
+    {
+        ID3D12CommandQueue* queue;
+
+        FrameLatencyScope(ID3D12CommandQueue* commandQueue, size_t frames) : queue(commandQueue)
+        {
+            ThrowIfFailed(MockD3D12::SetFrameLatency(queue, frames));
+        }
+
+        FrameLatencyScope(FrameLatencyScope const&) = delete;
+        FrameLatencyScope& operator=(FrameLatencyScope const&) = delete;
+
+        ~FrameLatencyScope()
+        {
+            std::ignore = MockD3D12::SetFrameLatency(queue, 0);
+        }
+    };
+}
+
+
+void Benchmarks::RunGraphicsMemoryBenchmarks(const Context& context)
+{
+    auto queue = context.queue.Get();
+
+    GraphicsMemory graphicsMemory(context.device.Get());
+
+    const unsigned int maxThreads = std::min(std::max(std::thread::hardware_concurrency(), 1u), c_MaxThreads);
+
+    for (const auto& test : c_Cases)
+    {
+        // Warm up so page creation isn't counted against the first thread count
+        std::ignore = MeasureFrames("warm up", graphicsMemory, queue, test, maxThreads);
+
+        double baseline = 0.;
+        for (unsigned int threadCount = 1; threadCount <= maxThreads; threadCount *= 2)
+        {
+            char name[64] = {};
+            snprintf(name, sizeof(name), "Allocate %s, %u thread(s), per frame", test.name, threadCount);
+
+            const double frame = MeasureFrames(name, graphicsMemory, queue, test, threadCount);
+
+            // Allocations per microsecond across all threads, relative to a single thread
+            const double rate = double(c_AllocationsPerThread) * threadCount / frame;
+            if (threadCount == 1)
+            {
+                baseline = rate;
+            }
+
+            printf("  %-48s %12.3f x\n", "  throughput vs. one thread", rate / baseline);
+        }
+    }
+}
+
+
+void Benchmarks::RunReplayBenchmarks(const Context& context)
+{
+    auto device = context.device.Get();
+    auto queue = context.queue.Get();
+
+    const auto trace = RecordTrace(device, queue);
+    printf("  %-48s %12zu bytes\n", "trace size", trace.size());
+
+    // GraphicsMemory is a per-device singleton, so each configuration replays in turn
+    for (const auto& test : c_ReplayCases)
+    {
+        GraphicsMemory graphicsMemory(device, test.flags);
+
+        char name[64] = {};
+        snprintf(name, sizeof(name), "ReplayTrace, %s", test.name);
+
+        GraphicsMemoryStatistics stats = {};
+        std::ignore = Measure(name, c_ReplayIterations, [&](size_t)
+            {
+                stats = graphicsMemory.ReplayTrace(trace.data(), trace.size(), queue);
+            });
+
+        printf("    peak %zu bytes in %zu pages, %zu ring buffer stalls, %zu fallbacks\n",
+            stats.peakTotalMemory, stats.peakTotalPages, stats.ringBufferStalls, stats.ringBufferFallbacks);
+    }
+}
+
+
+void Benchmarks::RunRetireBenchmarks(const Context& context)
+{
+    auto device = context.device.Get();
+    auto queue = context.queue.Get();
+
+    for (const size_t frames : c_FramesInFlight)
+    {
+        for (const size_t pages : c_PagesPerFrame)
+        {
+            GraphicsMemory graphicsMemory(device);
+            graphicsMemory.SetPageRetention(8);
+
+            const FrameLatencyScope latency(queue, frames);
+
+            std::vector<GraphicsResource> live;
+            live.reserve(pages);
+
+            // Only Commit and GarbageCollect are timed; the allocations and the mock GPU are not
+            std::chrono::duration<double, std::micro> elapsed(0);
+            for (size_t f = 0; f < c_RetireFrames + frames + 1; ++f)
+            {
+                for (size_t j = 0; j < pages; ++j)
+                {
+                    live.emplace_back(graphicsMemory.Allocate(c_PageAllocationSize, 16, GraphicsMemory::TAG_VERTEX));
+                }
+
+                live.clear();
+
+                const auto start = std::chrono::steady_clock::now();
+
+                graphicsMemory.Commit(queue);
+                graphicsMemory.GarbageCollect();
+
+                // The first frames fill the pipeline, so they are not counted
+                if (f > frames)
+                {
+                    elapsed += std::chrono::steady_clock::now() - start;
+                }
+
+                ThrowIfFailed(MockD3D12::EndFrame(queue));
+            }
+
+            char name[64] = {};
+            snprintf(name, sizeof(name), "Commit+GarbageCollect, %zu pages, %zu in flight", pages, frames);
+            printf("  %-48s %12.3f us\n", name, elapsed.count() / double(c_RetireFrames));
+
+            const auto stats = graphicsMemory.GetStatistics();
+            printf("    %zu pages allocated\n", stats.totalPages);
+        }
+    }
+}
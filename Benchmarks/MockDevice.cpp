@@ -0,0 +1,1447 @@
+//--------------------------------------------------------------------------------------
+// File: MockDevice.cpp
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//
+// https://go.microsoft.com/fwlink/?LinkID=615561
+//--------------------------------------------------------------------------------------
+
+#include "MockDevice.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace MockD3D12;
+
+namespace
+{
+    constexpr UINT c_DescriptorSize = 32;
+
+    constexpr UINT64 AlignUp(UINT64 value, UINT64 alignment) noexcept
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    //----------------------------------------------------------------------------------
+    // Texture layout, following the rules GetCopyableFootprints documents.
+
+    // Bytes in a 4x4 block for block compressed formats, otherwise zero
+    UINT BlockBytes(DXGI_FORMAT format) noexcept
+    {
+        if ((format >= DXGI_FORMAT_BC1_TYPELESS && format <= DXGI_FORMAT_BC1_UNORM_SRGB)
+            || (format >= DXGI_FORMAT_BC4_TYPELESS && format <= DXGI_FORMAT_BC4_SNORM))
+            return 8;
+
+        if ((format >= DXGI_FORMAT_BC2_TYPELESS && format <= DXGI_FORMAT_BC3_UNORM_SRGB)
+            || (format >= DXGI_FORMAT_BC5_TYPELESS && format <= DXGI_FORMAT_BC5_SNORM)
+            || (format >= DXGI_FORMAT_BC6H_TYPELESS && format <= DXGI_FORMAT_BC7_UNORM_SRGB))
+            return 16;
+
+        return 0;
+    }
+
+    UINT BitsPerPixel(DXGI_FORMAT format) noexcept
+    {
+        if (format >= DXGI_FORMAT_R32G32B32A32_TYPELESS && format <= DXGI_FORMAT_R32G32B32A32_SINT)
+            return 128;
+
+        if (format >= DXGI_FORMAT_R32G32B32_TYPELESS && format <= DXGI_FORMAT_R32G32B32_SINT)
+            return 96;
+
+        if (format >= DXGI_FORMAT_R16G16B16A16_TYPELESS && format <= DXGI_FORMAT_X32_TYPELESS_G8X24_UINT)
+            return 64;
+
+        if ((format >= DXGI_FORMAT_R8G8_TYPELESS && format <= DXGI_FORMAT_R16_SINT)
+            || format == DXGI_FORMAT_B5G6R5_UNORM
+            || format == DXGI_FORMAT_B5G5R5A1_UNORM
+            || format == DXGI_FORMAT_B4G4R4A4_UNORM)
+            return 16;
+
+        if ((format >= DXGI_FORMAT_R8_TYPELESS && format <= DXGI_FORMAT_A8_UNORM)
+            || format == DXGI_FORMAT_R1_UNORM)
+            return 8;
+
+        return 32;
+    }
+
+    UINT MipLevels(const D3D12_RESOURCE_DESC& desc) noexcept
+    {
+        if (desc.MipLevels > 0)
+            return desc.MipLevels;
+
+        UINT64 size = std::max<UINT64>(desc.Width, desc.Height);
+        if (desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D)
+        {
+            size = std::max<UINT64>(size, desc.DepthOrArraySize);
+        }
+
+        UINT levels = 1;
+        while (size > 1)
+        {
+            size >>= 1;
+            ++levels;
+        }
+        return levels;
+    }
+
+    UINT SubresourceCount(const D3D12_RESOURCE_DESC& desc) noexcept
+    {
+        if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+            return 1;
+
+        if (desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D)
+            return MipLevels(desc);
+
+        return MipLevels(desc) * desc.DepthOrArraySize;
+    }
+
+    void GetFootprints(
+        const D3D12_RESOURCE_DESC& desc,
+        UINT firstSubresource,
+        UINT numSubresources,
+        UINT64 baseOffset,
+        _Out_writes_opt_(numSubresources) D3D12_PLACED_SUBRESOURCE_FOOTPRINT* layouts,
+        _Out_writes_opt_(numSubresources) UINT* numRows,
+        _Out_writes_opt_(numSubresources) UINT64* rowSizes,
+        _Out_opt_ UINT64* totalBytes) noexcept
+    {
+        const bool valid = desc.Dimension != D3D12_RESOURCE_DIMENSION_UNKNOWN
+            && desc.Width > 0
+            && numSubresources > 0
+            && UINT64(firstSubresource) + numSubresources <= SubresourceCount(desc);
+
+        if (!valid)
+        {
+            for (UINT i = 0; i < numSubresources; ++i)
+            {
+                if (layouts)
+                    layouts[i] = D3D12_PLACED_SUBRESOURCE_FOOTPRINT{ UINT64(-1), {} };
+                if (numRows)
+                    numRows[i] = UINT(-1);
+                if (rowSizes)
+                    rowSizes[i] = UINT64(-1);
+            }
+            if (totalBytes)
+                *totalBytes = UINT64(-1);
+            return;
+        }
+
+        if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+        {
+            if (layouts)
+            {
+                layouts[0].Offset = baseOffset;
+                layouts[0].Footprint = { DXGI_FORMAT_UNKNOWN, static_cast<UINT>(desc.Width), 1, 1,
+                    static_cast<UINT>(AlignUp(desc.Width, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT)) };
+            }
+            if (numRows)
+                numRows[0] = 1;
+            if (rowSizes)
+                rowSizes[0] = desc.Width;
+            if (totalBytes)
+                *totalBytes = desc.Width;
+            return;
+        }
+
+        const UINT mipLevels = MipLevels(desc);
+        const UINT blockBytes = BlockBytes(desc.Format);
+
+        UINT64 offset = baseOffset;
+        UINT64 end = baseOffset;
+        for (UINT i = 0; i < numSubresources; ++i)
+        {
+            const UINT mip = (firstSubresource + i) % mipLevels;
+            UINT width = std::max(1u, static_cast<UINT>(desc.Width >> mip));
+            const UINT height = std::max(1u, desc.Height >> mip);
+            const UINT depth = (desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D)
+                ? std::max(1u, static_cast<UINT>(desc.DepthOrArraySize) >> mip) : 1u;
+
+            UINT rows = height;
+            UINT64 rowSize = (UINT64(width) * BitsPerPixel(desc.Format) + 7) / 8;
+            if (blockBytes)
+            {
+                rows = (height + 3) / 4;
+                rowSize = UINT64((width + 3) / 4) * blockBytes;
+                width = static_cast<UINT>(AlignUp(width, 4));
+            }
+
+            const UINT64 rowPitch = AlignUp(rowSize, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+            if (i > 0)
+            {
+                offset = AlignUp(end, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+            }
+
+            if (layouts)
+            {
+                layouts[i].Offset = offset;
+                const UINT footprintHeight = blockBytes ? static_cast<UINT>(AlignUp(height, 4)) : height;
+                layouts[i].Footprint = { desc.Format, width, footprintHeight, depth, static_cast<UINT>(rowPitch) };
+            }
+            if (numRows)
+                numRows[i] = rows;
+            if (rowSizes)
+                rowSizes[i] = rowSize;
+
+            end = offset + rowPitch * (UINT64(rows) * depth - 1) + rowSize;
+        }
+
+        if (totalBytes)
+            *totalBytes = end - baseOffset;
+    }
+
+    //----------------------------------------------------------------------------------
+    // Reference counting, QueryInterface and the ID3D12Object methods shared by every
+    // mock object. Each implements a single interface chain, so every supported IID
+    // maps to the same pointer.
+    template<typename Base>
+    class MockObject : public Base
+    {
+    public:
+        MockObject() noexcept : mRefCount(1) {}
+
+        MockObject(MockObject const&) = delete;
+        MockObject& operator= (MockObject const&) = delete;
+
+        HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override
+        {
+            if (!ppvObject)
+                return E_POINTER;
+
+            if (riid == __uuidof(IUnknown)
+                || riid == __uuidof(ID3D12Object)
+                || riid == __uuidof(Base)
+                || (std::is_base_of<ID3D12DeviceChild, Base>::value && riid == __uuidof(ID3D12DeviceChild))
+                || (std::is_base_of<ID3D12Pageable, Base>::value && riid == __uuidof(ID3D12Pageable))
+                || (std::is_base_of<ID3D12CommandList, Base>::value && riid == __uuidof(ID3D12CommandList)))
+            {
+                AddRef();
+                *ppvObject = static_cast<Base*>(this);
+                return S_OK;
+            }
+
+            *ppvObject = nullptr;
+            return E_NOINTERFACE;
+        }
+
+        ULONG STDMETHODCALLTYPE AddRef() override
+        {
+            return ++mRefCount;
+        }
+
+        ULONG STDMETHODCALLTYPE Release() override
+        {
+            const ULONG count = --mRefCount;
+            if (!count)
+            {
+                delete this;
+            }
+            return count;
+        }
+
+        HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, UINT* pDataSize, void*) override
+        {
+            if (pDataSize)
+                *pDataSize = 0;
+            return DXGI_ERROR_NOT_FOUND;
+        }
+
+        HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, UINT, const void*) override { return S_OK; }
+        HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown*) override { return S_OK; }
+        HRESULT STDMETHODCALLTYPE SetName(LPCWSTR) override { return S_OK; }
+
+    protected:
+        virtual ~MockObject() = default;
+
+    private:
+        std::atomic<ULONG> mRefCount;
+    };
+
+    // Hands a newly created object out through riid, dropping the creation reference.
+    // A null ppv only validates the call, as with the real device.
+    template<typename T>
+    HRESULT ReturnObject(T* object, REFIID riid, _COM_Outptr_opt_ void** ppv) noexcept
+    {
+        if (!object)
+        {
+            if (ppv)
+                *ppv = nullptr;
+            return E_OUTOFMEMORY;
+        }
+
+        if (!ppv)
+        {
+            object->Release();
+            return S_FALSE;
+        }
+
+        const HRESULT hr = object->QueryInterface(riid, ppv);
+        object->Release();
+        return hr;
+    }
+
+    class MockDevice;
+
+    template<typename Base>
+    class MockDeviceChild : public MockObject<Base>
+    {
+    public:
+        explicit MockDeviceChild(_In_ ID3D12Device* device) noexcept : mDevice(device)
+        {
+            mDevice->AddRef();
+        }
+
+        HRESULT STDMETHODCALLTYPE GetDevice(REFIID riid, void** ppvDevice) override
+        {
+            return mDevice->QueryInterface(riid, ppvDevice);
+        }
+
+    protected:
+        ~MockDeviceChild() override
+        {
+            mDevice->Release();
+        }
+
+        MockDevice* Device() const noexcept;
+
+    private:
+        ID3D12Device* mDevice;
+    };
+
+    //----------------------------------------------------------------------------------
+    // Objects with no behavior of their own.
+
+    class MockRootSignature : public MockDeviceChild<ID3D12RootSignature>
+    {
+    public:
+        using MockDeviceChild::MockDeviceChild;
+    };
+
+    class MockPipelineState : public MockDeviceChild<ID3D12PipelineState>
+    {
+    public:
+        using MockDeviceChild::MockDeviceChild;
+
+        HRESULT STDMETHODCALLTYPE GetCachedBlob(ID3DBlob** ppBlob) override
+        {
+            if (ppBlob)
+                *ppBlob = nullptr;
+            return E_NOTIMPL;
+        }
+    };
+
+    class MockCommandAllocator : public MockDeviceChild<ID3D12CommandAllocator>
+    {
+    public:
+        using MockDeviceChild::MockDeviceChild;
+
+        HRESULT STDMETHODCALLTYPE Reset() override { return S_OK; }
+    };
+
+    class MockHeap : public MockDeviceChild<ID3D12Heap>
+    {
+    public:
+        MockHeap(_In_ ID3D12Device* device, const D3D12_HEAP_DESC& desc) noexcept :
+            MockDeviceChild(device),
+            mDesc(desc)
+        {}
+
+    #if defined(_MSC_VER) || !defined(_WIN32)
+        D3D12_HEAP_DESC STDMETHODCALLTYPE GetDesc() override { return mDesc; }
+    #else
+        D3D12_HEAP_DESC* STDMETHODCALLTYPE GetDesc(D3D12_HEAP_DESC* RetVal) override { *RetVal = mDesc; return RetVal; }
+    #endif
+
+    private:
+        D3D12_HEAP_DESC mDesc;
+    };
+
+    //----------------------------------------------------------------------------------
+    class MockDescriptorHeap : public MockDeviceChild<ID3D12DescriptorHeap>
+    {
+    public:
+        MockDescriptorHeap(_In_ ID3D12Device* device, const D3D12_DESCRIPTOR_HEAP_DESC& desc) noexcept :
+            MockDeviceChild(device),
+            mDesc(desc),
+            mDescriptors(new (std::nothrow) uint8_t[size_t(std::max(desc.NumDescriptors, 1u)) * c_DescriptorSize])
+        {}
+
+        bool IsValid() const noexcept { return mDescriptors != nullptr; }
+
+    #if defined(_MSC_VER) || !defined(_WIN32)
+        D3D12_DESCRIPTOR_HEAP_DESC STDMETHODCALLTYPE GetDesc() override { return mDesc; }
+        D3D12_CPU_DESCRIPTOR_HANDLE STDMETHODCALLTYPE GetCPUDescriptorHandleForHeapStart() override { return CpuStart(); }
+        D3D12_GPU_DESCRIPTOR_HANDLE STDMETHODCALLTYPE GetGPUDescriptorHandleForHeapStart() override { return GpuStart(); }
+    #else
+        D3D12_DESCRIPTOR_HEAP_DESC* STDMETHODCALLTYPE GetDesc(D3D12_DESCRIPTOR_HEAP_DESC* RetVal) override { *RetVal = mDesc; return RetVal; }
+        D3D12_CPU_DESCRIPTOR_HANDLE* STDMETHODCALLTYPE GetCPUDescriptorHandleForHeapStart(D3D12_CPU_DESCRIPTOR_HANDLE* RetVal) override { *RetVal = CpuStart(); return RetVal; }
+        D3D12_GPU_DESCRIPTOR_HANDLE* STDMETHODCALLTYPE GetGPUDescriptorHandleForHeapStart(D3D12_GPU_DESCRIPTOR_HANDLE* RetVal) override { *RetVal = GpuStart(); return RetVal; }
+    #endif
+
+    private:
+        D3D12_DESCRIPTOR_HEAP_DESC  mDesc;
+        std::unique_ptr<uint8_t[]>  mDescriptors;
+
+        D3D12_CPU_DESCRIPTOR_HANDLE CpuStart() const noexcept
+        {
+            return D3D12_CPU_DESCRIPTOR_HANDLE{ reinterpret_cast<SIZE_T>(mDescriptors.get()) };
+        }
+
+        D3D12_GPU_DESCRIPTOR_HANDLE GpuStart() const noexcept
+        {
+            // Only shader visible heaps have a GPU address
+            if (!(mDesc.Flags & D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE))
+                return D3D12_GPU_DESCRIPTOR_HANDLE{ 0 };
+
+            return D3D12_GPU_DESCRIPTOR_HANDLE{ reinterpret_cast<UINT64>(mDescriptors.get()) };
+        }
+    };
+
+    //----------------------------------------------------------------------------------
+    class MockResource : public MockDeviceChild<ID3D12Resource>
+    {
+    public:
+        MockResource(
+            _In_ ID3D12Device* device,
+            const D3D12_RESOURCE_DESC& desc,
+            const D3D12_HEAP_PROPERTIES& heapProperties,
+            D3D12_HEAP_FLAGS heapFlags) noexcept :
+            MockDeviceChild(device),
+            mDesc(desc),
+            mHeapProperties(heapProperties),
+            mHeapFlags(heapFlags),
+            mSize(0)
+        {
+            mDesc.MipLevels = static_cast<UINT16>(MipLevels(desc));
+        }
+
+        // Lays out the subresources and allocates their memory
+        HRESULT Initialize() noexcept
+        {
+            const UINT count = SubresourceCount(mDesc);
+
+            UINT64 totalBytes = 0;
+            try
+            {
+                mLayouts.resize(count);
+                mNumRows.resize(count);
+                mRowSizes.resize(count);
+            }
+            catch (const std::bad_alloc&)
+            {
+                return E_OUTOFMEMORY;
+            }
+
+            GetFootprints(mDesc, 0, count, 0, mLayouts.data(), mNumRows.data(), mRowSizes.data(), &totalBytes);
+            if (totalBytes == UINT64(-1) || totalBytes > SIZE_MAX)
+                return E_INVALIDARG;
+
+            mSize = static_cast<size_t>(totalBytes);
+            mData.reset(new (std::nothrow) uint8_t[std::max<size_t>(mSize, 1)]);
+            if (!mData)
+                return E_OUTOFMEMORY;
+
+            return S_OK;
+        }
+
+        size_t Size() const noexcept { return mSize; }
+        uint8_t* Data() const noexcept { return mData.get(); }
+
+        const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& Layout(UINT subresource) const noexcept { return mLayouts[subresource]; }
+        UINT NumRows(UINT subresource) const noexcept { return mNumRows[subresource]; }
+        UINT64 RowSize(UINT subresource) const noexcept { return mRowSizes[subresource]; }
+        UINT Subresources() const noexcept { return static_cast<UINT>(mLayouts.size()); }
+
+        HRESULT STDMETHODCALLTYPE Map(UINT Subresource, const D3D12_RANGE*, void** ppData) override
+        {
+            if (Subresource >= mLayouts.size())
+                return E_INVALIDARG;
+
+            if (ppData)
+            {
+                *ppData = mData.get() + mLayouts[Subresource].Offset;
+            }
+            return S_OK;
+        }
+
+        void STDMETHODCALLTYPE Unmap(UINT, const D3D12_RANGE*) override {}
+
+    #if defined(_MSC_VER) || !defined(_WIN32)
+        D3D12_RESOURCE_DESC STDMETHODCALLTYPE GetDesc() override { return mDesc; }
+    #else
+        D3D12_RESOURCE_DESC* STDMETHODCALLTYPE GetDesc(D3D12_RESOURCE_DESC* RetVal) override { *RetVal = mDesc; return RetVal; }
+    #endif
+
+        D3D12_GPU_VIRTUAL_ADDRESS STDMETHODCALLTYPE GetGPUVirtualAddress() override
+        {
+            // Only buffers have a GPU virtual address
+            if (mDesc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER)
+                return 0;
+
+            return reinterpret_cast<D3D12_GPU_VIRTUAL_ADDRESS>(mData.get());
+        }
+
+        HRESULT STDMETHODCALLTYPE WriteToSubresource(UINT, const D3D12_BOX*, const void*, UINT, UINT) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE ReadFromSubresource(void*, UINT, UINT, UINT, const D3D12_BOX*) override { return E_NOTIMPL; }
+
+        HRESULT STDMETHODCALLTYPE GetHeapProperties(D3D12_HEAP_PROPERTIES* pHeapProperties, D3D12_HEAP_FLAGS* pHeapFlags) override
+        {
+            if (pHeapProperties)
+                *pHeapProperties = mHeapProperties;
+            if (pHeapFlags)
+                *pHeapFlags = mHeapFlags;
+            return S_OK;
+        }
+
+    private:
+        D3D12_RESOURCE_DESC                             mDesc;
+        D3D12_HEAP_PROPERTIES                           mHeapProperties;
+        D3D12_HEAP_FLAGS                                mHeapFlags;
+        size_t                                          mSize;
+        std::unique_ptr<uint8_t[]>                      mData;
+        std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> mLayouts;
+        std::vector<UINT>                               mNumRows;
+        std::vector<UINT64>                             mRowSizes;
+    };
+
+    //----------------------------------------------------------------------------------
+    class MockFence : public MockDeviceChild<ID3D12Fence>
+    {
+    public:
+        MockFence(_In_ ID3D12Device* device, UINT64 initialValue) noexcept :
+            MockDeviceChild(device),
+            mValue(initialValue)
+        {}
+
+        UINT64 STDMETHODCALLTYPE GetCompletedValue() override
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            return mValue;
+        }
+
+        HRESULT STDMETHODCALLTYPE SetEventOnCompletion(UINT64 Value, HANDLE hEvent) override
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+
+            if (Value <= mValue)
+            {
+                if (hEvent)
+                {
+                    SetEvent(hEvent);
+                }
+                return S_OK;
+            }
+
+            // A null event blocks until the value is reached
+            if (!hEvent)
+            {
+                mSignaled.wait(lock, [&]() { return Value <= mValue; });
+                return S_OK;
+            }
+
+            try
+            {
+                mEvents.emplace_back(Value, hEvent);
+            }
+            catch (const std::bad_alloc&)
+            {
+                return E_OUTOFMEMORY;
+            }
+            return S_OK;
+        }
+
+        HRESULT STDMETHODCALLTYPE Signal(UINT64 Value) override
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            mValue = Value;
+
+            auto pending = std::partition(mEvents.begin(), mEvents.end(),
+                [=](const std::pair<UINT64, HANDLE>& e) { return e.first > Value; });
+
+            for (auto it = pending; it != mEvents.end(); ++it)
+            {
+                SetEvent(it->second);
+            }
+            mEvents.erase(pending, mEvents.end());
+
+            mSignaled.notify_all();
+            return S_OK;
+        }
+
+    private:
+        std::mutex                                  mMutex;
+        std::condition_variable                     mSignaled;
+        UINT64                                      mValue;
+        std::vector<std::pair<UINT64, HANDLE>>      mEvents;
+    };
+
+    //----------------------------------------------------------------------------------
+    // Records copies for ExecuteCommandLists and counts everything else.
+    class MockCommandList : public MockDeviceChild<ID3D12GraphicsCommandList>
+    {
+    public:
+        MockCommandList(_In_ ID3D12Device* device, D3D12_COMMAND_LIST_TYPE type) noexcept :
+            MockDeviceChild(device),
+            mType(type),
+            mClosed(false),
+            mStats{}
+        {}
+
+        // Runs the recorded copies against host memory, and adds the recorded work to stats
+        void Execute(Statistics& stats) const noexcept;
+
+        D3D12_COMMAND_LIST_TYPE STDMETHODCALLTYPE GetType() override { return mType; }
+
+        HRESULT STDMETHODCALLTYPE Close() override
+        {
+            if (mClosed)
+                return E_FAIL;
+
+            mClosed = true;
+            return S_OK;
+        }
+
+        HRESULT STDMETHODCALLTYPE Reset(ID3D12CommandAllocator*, ID3D12PipelineState*) override
+        {
+            if (!mClosed)
+                return E_FAIL;
+
+            mClosed = false;
+            mCopies.clear();
+            mStats = {};
+            return S_OK;
+        }
+
+        void STDMETHODCALLTYPE ClearState(ID3D12PipelineState*) override {}
+
+        void STDMETHODCALLTYPE DrawInstanced(UINT, UINT InstanceCount, UINT, UINT) override
+        {
+            ++mStats.draws;
+            mStats.instances += InstanceCount;
+        }
+
+        void STDMETHODCALLTYPE DrawIndexedInstanced(UINT, UINT InstanceCount, UINT, INT, UINT) override
+        {
+            ++mStats.draws;
+            mStats.instances += InstanceCount;
+        }
+
+        void STDMETHODCALLTYPE Dispatch(UINT, UINT, UINT) override
+        {
+            ++mStats.dispatches;
+        }
+
+        void STDMETHODCALLTYPE CopyBufferRegion(ID3D12Resource* pDstBuffer, UINT64 DstOffset, ID3D12Resource* pSrcBuffer, UINT64 SrcOffset, UINT64 NumBytes) override
+        {
+            Copy copy = {};
+            copy.type = CopyType::Buffer;
+            copy.dst.pResource = pDstBuffer;
+            copy.src.pResource = pSrcBuffer;
+            copy.dstOffset = DstOffset;
+            copy.srcOffset = SrcOffset;
+            copy.bytes = NumBytes;
+            mCopies.push_back(copy);
+        }
+
+        void STDMETHODCALLTYPE CopyTextureRegion(const D3D12_TEXTURE_COPY_LOCATION* pDst, UINT, UINT, UINT, const D3D12_TEXTURE_COPY_LOCATION* pSrc, const D3D12_BOX*) override
+        {
+            // Copies are made to the origin of the destination, which is how the toolkit uses them
+            Copy copy = {};
+            copy.type = CopyType::Texture;
+            copy.dst = *pDst;
+            copy.src = *pSrc;
+            mCopies.push_back(copy);
+        }
+
+        void STDMETHODCALLTYPE CopyResource(ID3D12Resource* pDstResource, ID3D12Resource* pSrcResource) override
+        {
+            Copy copy = {};
+            copy.type = CopyType::Resource;
+            copy.dst.pResource = pDstResource;
+            copy.src.pResource = pSrcResource;
+            mCopies.push_back(copy);
+        }
+
+        void STDMETHODCALLTYPE CopyTiles(ID3D12Resource*, const D3D12_TILED_RESOURCE_COORDINATE*, const D3D12_TILE_REGION_SIZE*, ID3D12Resource*, UINT64, D3D12_TILE_COPY_FLAGS) override {}
+        void STDMETHODCALLTYPE ResolveSubresource(ID3D12Resource*, UINT, ID3D12Resource*, UINT, DXGI_FORMAT) override {}
+        void STDMETHODCALLTYPE IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY) override {}
+        void STDMETHODCALLTYPE RSSetViewports(UINT, const D3D12_VIEWPORT*) override {}
+        void STDMETHODCALLTYPE RSSetScissorRects(UINT, const D3D12_RECT*) override {}
+        void STDMETHODCALLTYPE OMSetBlendFactor(const FLOAT[4]) override {}
+        void STDMETHODCALLTYPE OMSetStencilRef(UINT) override {}
+        void STDMETHODCALLTYPE SetPipelineState(ID3D12PipelineState*) override {}
+
+        void STDMETHODCALLTYPE ResourceBarrier(UINT NumBarriers, const D3D12_RESOURCE_BARRIER*) override
+        {
+            mStats.barriers += NumBarriers;
+            ++mStats.barrierCalls;
+        }
+
+        void STDMETHODCALLTYPE ExecuteBundle(ID3D12GraphicsCommandList*) override {}
+        void STDMETHODCALLTYPE SetDescriptorHeaps(UINT, ID3D12DescriptorHeap* const*) override {}
+        void STDMETHODCALLTYPE SetComputeRootSignature(ID3D12RootSignature*) override {}
+        void STDMETHODCALLTYPE SetGraphicsRootSignature(ID3D12RootSignature*) override {}
+        void STDMETHODCALLTYPE SetComputeRootDescriptorTable(UINT, D3D12_GPU_DESCRIPTOR_HANDLE) override {}
+        void STDMETHODCALLTYPE SetGraphicsRootDescriptorTable(UINT, D3D12_GPU_DESCRIPTOR_HANDLE) override {}
+        void STDMETHODCALLTYPE SetComputeRoot32BitConstant(UINT, UINT, UINT) override {}
+        void STDMETHODCALLTYPE SetGraphicsRoot32BitConstant(UINT, UINT, UINT) override {}
+        void STDMETHODCALLTYPE SetComputeRoot32BitConstants(UINT, UINT, const void*, UINT) override {}
+        void STDMETHODCALLTYPE SetGraphicsRoot32BitConstants(UINT, UINT, const void*, UINT) override {}
+        void STDMETHODCALLTYPE SetComputeRootConstantBufferView(UINT, D3D12_GPU_VIRTUAL_ADDRESS) override {}
+        void STDMETHODCALLTYPE SetGraphicsRootConstantBufferView(UINT, D3D12_GPU_VIRTUAL_ADDRESS) override {}
+        void STDMETHODCALLTYPE SetComputeRootShaderResourceView(UINT, D3D12_GPU_VIRTUAL_ADDRESS) override {}
+        void STDMETHODCALLTYPE SetGraphicsRootShaderResourceView(UINT, D3D12_GPU_VIRTUAL_ADDRESS) override {}
+        void STDMETHODCALLTYPE SetComputeRootUnorderedAccessView(UINT, D3D12_GPU_VIRTUAL_ADDRESS) override {}
+        void STDMETHODCALLTYPE SetGraphicsRootUnorderedAccessView(UINT, D3D12_GPU_VIRTUAL_ADDRESS) override {}
+        void STDMETHODCALLTYPE IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW*) override {}
+        void STDMETHODCALLTYPE IASetVertexBuffers(UINT, UINT, const D3D12_VERTEX_BUFFER_VIEW*) override {}
+        void STDMETHODCALLTYPE SOSetTargets(UINT, UINT, const D3D12_STREAM_OUTPUT_BUFFER_VIEW*) override {}
+        void STDMETHODCALLTYPE OMSetRenderTargets(UINT, const D3D12_CPU_DESCRIPTOR_HANDLE*, BOOL, const D3D12_CPU_DESCRIPTOR_HANDLE*) override {}
+        void STDMETHODCALLTYPE ClearDepthStencilView(D3D12_CPU_DESCRIPTOR_HANDLE, D3D12_CLEAR_FLAGS, FLOAT, UINT8, UINT, const D3D12_RECT*) override {}
+        void STDMETHODCALLTYPE ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE, const FLOAT[4], UINT, const D3D12_RECT*) override {}
+        void STDMETHODCALLTYPE ClearUnorderedAccessViewUint(D3D12_GPU_DESCRIPTOR_HANDLE, D3D12_CPU_DESCRIPTOR_HANDLE, ID3D12Resource*, const UINT[4], UINT, const D3D12_RECT*) override {}
+        void STDMETHODCALLTYPE ClearUnorderedAccessViewFloat(D3D12_GPU_DESCRIPTOR_HANDLE, D3D12_CPU_DESCRIPTOR_HANDLE, ID3D12Resource*, const FLOAT[4], UINT, const D3D12_RECT*) override {}
+        void STDMETHODCALLTYPE DiscardResource(ID3D12Resource*, const D3D12_DISCARD_REGION*) override {}
+        void STDMETHODCALLTYPE BeginQuery(ID3D12QueryHeap*, D3D12_QUERY_TYPE, UINT) override {}
+        void STDMETHODCALLTYPE EndQuery(ID3D12QueryHeap*, D3D12_QUERY_TYPE, UINT) override {}
+        void STDMETHODCALLTYPE ResolveQueryData(ID3D12QueryHeap*, D3D12_QUERY_TYPE, UINT, UINT, ID3D12Resource*, UINT64) override {}
+        void STDMETHODCALLTYPE SetPredication(ID3D12Resource*, UINT64, D3D12_PREDICATION_OP) override {}
+        void STDMETHODCALLTYPE SetMarker(UINT, const void*, UINT) override {}
+        void STDMETHODCALLTYPE BeginEvent(UINT, const void*, UINT) override {}
+        void STDMETHODCALLTYPE EndEvent() override {}
+        void STDMETHODCALLTYPE ExecuteIndirect(ID3D12CommandSignature*, UINT, ID3D12Resource*, UINT64, ID3D12Resource*, UINT64) override {}
+
+    private:
+        enum class CopyType
+        {
+            Buffer,
+            Texture,
+            Resource,
+        };
+
+        struct Copy
+        {
+            CopyType                        type;
+            D3D12_TEXTURE_COPY_LOCATION     dst;
+            D3D12_TEXTURE_COPY_LOCATION     src;
+            UINT64                          dstOffset;
+            UINT64                          srcOffset;
+            UINT64                          bytes;
+        };
+
+        D3D12_COMMAND_LIST_TYPE     mType;
+        bool                        mClosed;
+        std::vector<Copy>           mCopies;
+        Statistics                  mStats;
+    };
+
+    //----------------------------------------------------------------------------------
+    class MockCommandQueue : public MockDeviceChild<ID3D12CommandQueue>
+    {
+    public:
+        MockCommandQueue(_In_ ID3D12Device* device, const D3D12_COMMAND_QUEUE_DESC& desc) noexcept :
+            MockDeviceChild(device),
+            mDesc(desc),
+            mLatency(0)
+        {}
+
+        ~MockCommandQueue() override
+        {
+            std::ignore = SetFrameLatency(0);
+        }
+
+        void STDMETHODCALLTYPE UpdateTileMappings(ID3D12Resource*, UINT, const D3D12_TILED_RESOURCE_COORDINATE*, const D3D12_TILE_REGION_SIZE*, ID3D12Heap*, UINT, const D3D12_TILE_RANGE_FLAGS*, const UINT*, const UINT*, D3D12_TILE_MAPPING_FLAGS) override {}
+        void STDMETHODCALLTYPE CopyTileMappings(ID3D12Resource*, const D3D12_TILED_RESOURCE_COORDINATE*, ID3D12Resource*, const D3D12_TILED_RESOURCE_COORDINATE*, const D3D12_TILE_REGION_SIZE*, D3D12_TILE_MAPPING_FLAGS) override {}
+
+        void STDMETHODCALLTYPE ExecuteCommandLists(UINT NumCommandLists, ID3D12CommandList* const* ppCommandLists) override;
+
+        void STDMETHODCALLTYPE SetMarker(UINT, const void*, UINT) override {}
+        void STDMETHODCALLTYPE BeginEvent(UINT, const void*, UINT) override {}
+        void STDMETHODCALLTYPE EndEvent() override {}
+
+        // Work runs in ExecuteCommandLists, so a fence is complete as soon as it is signaled,
+        // unless SetFrameLatency is holding signals back
+        HRESULT STDMETHODCALLTYPE Signal(ID3D12Fence* pFence, UINT64 Value) override
+        {
+            if (!pFence)
+                return E_INVALIDARG;
+
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+
+                if (mLatency > 0)
+                {
+                    try
+                    {
+                        mOpenFrame.push_back({ pFence, Value });
+                    }
+                    catch (const std::bad_alloc&)
+                    {
+                        return E_OUTOFMEMORY;
+                    }
+
+                    pFence->AddRef();
+                    return S_OK;
+                }
+            }
+
+            return pFence->Signal(Value);
+        }
+
+        HRESULT STDMETHODCALLTYPE Wait(ID3D12Fence*, UINT64) override { return S_OK; }
+
+        HRESULT STDMETHODCALLTYPE GetTimestampFrequency(UINT64* pFrequency) override
+        {
+            if (!pFrequency)
+                return E_INVALIDARG;
+
+            LARGE_INTEGER frequency;
+            QueryPerformanceFrequency(&frequency);
+            *pFrequency = static_cast<UINT64>(frequency.QuadPart);
+            return S_OK;
+        }
+
+        HRESULT STDMETHODCALLTYPE GetClockCalibration(UINT64* pGpuTimestamp, UINT64* pCpuTimestamp) override
+        {
+            if (!pGpuTimestamp || !pCpuTimestamp)
+                return E_INVALIDARG;
+
+            LARGE_INTEGER counter;
+            QueryPerformanceCounter(&counter);
+            *pGpuTimestamp = *pCpuTimestamp = static_cast<UINT64>(counter.QuadPart);
+            return S_OK;
+        }
+
+    #if defined(_MSC_VER) || !defined(_WIN32)
+        D3D12_COMMAND_QUEUE_DESC STDMETHODCALLTYPE GetDesc() override { return mDesc; }
+    #else
+        D3D12_COMMAND_QUEUE_DESC* STDMETHODCALLTYPE GetDesc(D3D12_COMMAND_QUEUE_DESC* RetVal) override { *RetVal = mDesc; return RetVal; }
+    #endif
+
+        HRESULT SetFrameLatency(size_t frames) noexcept
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            mLatency = frames;
+
+            CompleteFrames(frames);
+
+            if (frames == 0)
+            {
+                CompleteSignals(mOpenFrame);
+            }
+            return S_OK;
+        }
+
+        HRESULT EndFrame() noexcept
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            if (mLatency == 0)
+                return S_OK;
+
+            try
+            {
+                mFrames.push_back(std::move(mOpenFrame));
+            }
+            catch (const std::bad_alloc&)
+            {
+                return E_OUTOFMEMORY;
+            }
+
+            mOpenFrame.clear();
+
+            CompleteFrames(mLatency);
+            return S_OK;
+        }
+
+    private:
+        struct PendingSignal
+        {
+            ID3D12Fence*    fence;
+            UINT64          value;
+        };
+
+        // Completes the oldest ended frames until no more than the given number are held
+        void CompleteFrames(size_t latency) noexcept
+        {
+            while (mFrames.size() > latency)
+            {
+                CompleteSignals(mFrames.front());
+                mFrames.pop_front();
+            }
+        }
+
+        static void CompleteSignals(std::vector<PendingSignal>& signals) noexcept
+        {
+            for (const auto& signal : signals)
+            {
+                std::ignore = signal.fence->Signal(signal.value);
+                signal.fence->Release();
+            }
+
+            signals.clear();
+        }
+
+        D3D12_COMMAND_QUEUE_DESC                    mDesc;
+        std::mutex                                  mMutex;
+        size_t                                      mLatency;
+        std::vector<PendingSignal>                  mOpenFrame;
+        std::deque<std::vector<PendingSignal>>      mFrames;
+    };
+
+    //----------------------------------------------------------------------------------
+    class MockDevice : public MockObject<ID3D12Device>
+    {
+    public:
+        MockDevice() noexcept :
+            mResources(0),
+            mResourceBytes(0),
+            mExecutions(0),
+            mDraws(0),
+            mInstances(0),
+            mDispatches(0),
+            mBarriers(0),
+            mBarrierCalls(0),
+            mCopies(0),
+            mBytesCopied(0)
+        {}
+
+        Statistics GetStatistics() const noexcept
+        {
+            Statistics stats = {};
+            stats.resources = mResources;
+            stats.resourceBytes = mResourceBytes;
+            stats.executions = mExecutions;
+            stats.draws = mDraws;
+            stats.instances = mInstances;
+            stats.dispatches = mDispatches;
+            stats.barriers = mBarriers;
+            stats.barrierCalls = mBarrierCalls;
+            stats.copies = mCopies;
+            stats.bytesCopied = mBytesCopied;
+            return stats;
+        }
+
+        void AddExecution(const Statistics& stats) noexcept
+        {
+            ++mExecutions;
+            mDraws += stats.draws;
+            mInstances += stats.instances;
+            mDispatches += stats.dispatches;
+            mBarriers += stats.barriers;
+            mBarrierCalls += stats.barrierCalls;
+            mCopies += stats.copies;
+            mBytesCopied += stats.bytesCopied;
+        }
+
+        UINT STDMETHODCALLTYPE GetNodeCount() override { return 1; }
+
+        HRESULT STDMETHODCALLTYPE CreateCommandQueue(const D3D12_COMMAND_QUEUE_DESC* pDesc, REFIID riid, void** ppCommandQueue) override
+        {
+            if (!pDesc)
+                return E_INVALIDARG;
+
+            return ReturnObject(new (std::nothrow) MockCommandQueue(this, *pDesc), riid, ppCommandQueue);
+        }
+
+        HRESULT STDMETHODCALLTYPE CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE, REFIID riid, void** ppCommandAllocator) override
+        {
+            return ReturnObject(new (std::nothrow) MockCommandAllocator(this), riid, ppCommandAllocator);
+        }
+
+        HRESULT STDMETHODCALLTYPE CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC* pDesc, REFIID riid, void** ppPipelineState) override
+        {
+            if (!pDesc)
+                return E_INVALIDARG;
+
+            return ReturnObject(new (std::nothrow) MockPipelineState(this), riid, ppPipelineState);
+        }
+
+        HRESULT STDMETHODCALLTYPE CreateComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC* pDesc, REFIID riid, void** ppPipelineState) override
+        {
+            if (!pDesc)
+                return E_INVALIDARG;
+
+            return ReturnObject(new (std::nothrow) MockPipelineState(this), riid, ppPipelineState);
+        }
+
+        HRESULT STDMETHODCALLTYPE CreateCommandList(UINT, D3D12_COMMAND_LIST_TYPE type, ID3D12CommandAllocator* pCommandAllocator, ID3D12PipelineState*, REFIID riid, void** ppCommandList) override
+        {
+            if (!pCommandAllocator)
+                return E_INVALIDARG;
+
+            return ReturnObject(new (std::nothrow) MockCommandList(this, type), riid, ppCommandList);
+        }
+
+        HRESULT STDMETHODCALLTYPE CheckFeatureSupport(D3D12_FEATURE Feature, void* pFeatureSupportData, UINT FeatureSupportDataSize) override;
+
+        HRESULT STDMETHODCALLTYPE CreateDescriptorHeap(const D3D12_DESCRIPTOR_HEAP_DESC* pDescriptorHeapDesc, REFIID riid, void** ppvHeap) override
+        {
+            if (!pDescriptorHeapDesc)
+                return E_INVALIDARG;
+
+            auto heap = new (std::nothrow) MockDescriptorHeap(this, *pDescriptorHeapDesc);
+            if (heap && !heap->IsValid())
+            {
+                heap->Release();
+                heap = nullptr;
+            }
+
+            return ReturnObject(heap, riid, ppvHeap);
+        }
+
+        UINT STDMETHODCALLTYPE GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE) override { return c_DescriptorSize; }
+
+        HRESULT STDMETHODCALLTYPE CreateRootSignature(UINT, const void* pBlobWithRootSignature, SIZE_T blobLengthInBytes, REFIID riid, void** ppvRootSignature) override
+        {
+            if (!pBlobWithRootSignature || !blobLengthInBytes)
+                return E_INVALIDARG;
+
+            return ReturnObject(new (std::nothrow) MockRootSignature(this), riid, ppvRootSignature);
+        }
+
+        // Descriptors are not interpreted
+        void STDMETHODCALLTYPE CreateConstantBufferView(const D3D12_CONSTANT_BUFFER_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE) override {}
+        void STDMETHODCALLTYPE CreateShaderResourceView(ID3D12Resource*, const D3D12_SHADER_RESOURCE_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE) override {}
+        void STDMETHODCALLTYPE CreateUnorderedAccessView(ID3D12Resource*, ID3D12Resource*, const D3D12_UNORDERED_ACCESS_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE) override {}
+        void STDMETHODCALLTYPE CreateRenderTargetView(ID3D12Resource*, const D3D12_RENDER_TARGET_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE) override {}
+        void STDMETHODCALLTYPE CreateDepthStencilView(ID3D12Resource*, const D3D12_DEPTH_STENCIL_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE) override {}
+        void STDMETHODCALLTYPE CreateSampler(const D3D12_SAMPLER_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE) override {}
+        void STDMETHODCALLTYPE CopyDescriptors(UINT, const D3D12_CPU_DESCRIPTOR_HANDLE*, const UINT*, UINT, const D3D12_CPU_DESCRIPTOR_HANDLE*, const UINT*, D3D12_DESCRIPTOR_HEAP_TYPE) override {}
+        void STDMETHODCALLTYPE CopyDescriptorsSimple(UINT, D3D12_CPU_DESCRIPTOR_HANDLE, D3D12_CPU_DESCRIPTOR_HANDLE, D3D12_DESCRIPTOR_HEAP_TYPE) override {}
+
+    #if defined(_MSC_VER) || !defined(_WIN32)
+        D3D12_RESOURCE_ALLOCATION_INFO STDMETHODCALLTYPE GetResourceAllocationInfo(UINT, UINT numResourceDescs, const D3D12_RESOURCE_DESC* pResourceDescs) override
+        {
+            return AllocationInfo(numResourceDescs, pResourceDescs);
+        }
+
+        D3D12_HEAP_PROPERTIES STDMETHODCALLTYPE GetCustomHeapProperties(UINT nodeMask, D3D12_HEAP_TYPE heapType) override
+        {
+            return CustomHeapProperties(nodeMask, heapType);
+        }
+    #else
+        D3D12_RESOURCE_ALLOCATION_INFO* STDMETHODCALLTYPE GetResourceAllocationInfo(D3D12_RESOURCE_ALLOCATION_INFO* RetVal, UINT, UINT numResourceDescs, const D3D12_RESOURCE_DESC* pResourceDescs) override
+        {
+            *RetVal = AllocationInfo(numResourceDescs, pResourceDescs);
+            return RetVal;
+        }
+
+        D3D12_HEAP_PROPERTIES* STDMETHODCALLTYPE GetCustomHeapProperties(D3D12_HEAP_PROPERTIES* RetVal, UINT nodeMask, D3D12_HEAP_TYPE heapType) override
+        {
+            *RetVal = CustomHeapProperties(nodeMask, heapType);
+            return RetVal;
+        }
+    #endif
+
+        HRESULT STDMETHODCALLTYPE CreateCommittedResource(const D3D12_HEAP_PROPERTIES* pHeapProperties, D3D12_HEAP_FLAGS HeapFlags, const D3D12_RESOURCE_DESC* pDesc, D3D12_RESOURCE_STATES, const D3D12_CLEAR_VALUE*, REFIID riidResource, void** ppvResource) override
+        {
+            if (!pHeapProperties)
+                return E_INVALIDARG;
+
+            return CreateResource(*pHeapProperties, HeapFlags, pDesc, riidResource, ppvResource);
+        }
+
+        HRESULT STDMETHODCALLTYPE CreateHeap(const D3D12_HEAP_DESC* pDesc, REFIID riid, void** ppvHeap) override
+        {
+            if (!pDesc)
+                return E_INVALIDARG;
+
+            return ReturnObject(new (std::nothrow) MockHeap(this, *pDesc), riid, ppvHeap);
+        }
+
+        HRESULT STDMETHODCALLTYPE CreatePlacedResource(ID3D12Heap* pHeap, UINT64, const D3D12_RESOURCE_DESC* pDesc, D3D12_RESOURCE_STATES, const D3D12_CLEAR_VALUE*, REFIID riid, void** ppvResource) override
+        {
+            if (!pHeap)
+                return E_INVALIDARG;
+
+        #if defined(_MSC_VER) || !defined(_WIN32)
+            const auto heapDesc = pHeap->GetDesc();
+        #else
+            D3D12_HEAP_DESC tmpDesc;
+            const auto& heapDesc = *pHeap->GetDesc(&tmpDesc);
+        #endif
+
+            return CreateResource(heapDesc.Properties, heapDesc.Flags, pDesc, riid, ppvResource);
+        }
+
+        HRESULT STDMETHODCALLTYPE CreateReservedResource(const D3D12_RESOURCE_DESC*, D3D12_RESOURCE_STATES, const D3D12_CLEAR_VALUE*, REFIID, void** ppvResource) override
+        {
+            if (ppvResource)
+                *ppvResource = nullptr;
+            return E_NOTIMPL;
+        }
+
+        HRESULT STDMETHODCALLTYPE CreateSharedHandle(ID3D12DeviceChild*, const SECURITY_ATTRIBUTES*, DWORD, LPCWSTR, HANDLE*) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE OpenSharedHandle(HANDLE, REFIID, void**) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE OpenSharedHandleByName(LPCWSTR, DWORD, HANDLE*) override { return E_NOTIMPL; }
+        HRESULT STDMETHODCALLTYPE MakeResident(UINT, ID3D12Pageable* const*) override { return S_OK; }
+        HRESULT STDMETHODCALLTYPE Evict(UINT, ID3D12Pageable* const*) override { return S_OK; }
+
+        HRESULT STDMETHODCALLTYPE CreateFence(UINT64 InitialValue, D3D12_FENCE_FLAGS, REFIID riid, void** ppFence) override
+        {
+            return ReturnObject(new (std::nothrow) MockFence(this, InitialValue), riid, ppFence);
+        }
+
+        HRESULT STDMETHODCALLTYPE GetDeviceRemovedReason() override { return S_OK; }
+
+        void STDMETHODCALLTYPE GetCopyableFootprints(const D3D12_RESOURCE_DESC* pResourceDesc, UINT FirstSubresource, UINT NumSubresources, UINT64 BaseOffset, D3D12_PLACED_SUBRESOURCE_FOOTPRINT* pLayouts, UINT* pNumRows, UINT64* pRowSizeInBytes, UINT64* pTotalBytes) override
+        {
+            if (!pResourceDesc)
+            {
+                if (pTotalBytes)
+                    *pTotalBytes = UINT64(-1);
+                return;
+            }
+
+            GetFootprints(*pResourceDesc, FirstSubresource, NumSubresources, BaseOffset, pLayouts, pNumRows, pRowSizeInBytes, pTotalBytes);
+        }
+
+        HRESULT STDMETHODCALLTYPE CreateQueryHeap(const D3D12_QUERY_HEAP_DESC*, REFIID, void** ppvHeap) override
+        {
+            if (ppvHeap)
+                *ppvHeap = nullptr;
+            return E_NOTIMPL;
+        }
+
+        HRESULT STDMETHODCALLTYPE SetStablePowerState(BOOL) override { return S_OK; }
+
+        HRESULT STDMETHODCALLTYPE CreateCommandSignature(const D3D12_COMMAND_SIGNATURE_DESC*, ID3D12RootSignature*, REFIID, void** ppvCommandSignature) override
+        {
+            if (ppvCommandSignature)
+                *ppvCommandSignature = nullptr;
+            return E_NOTIMPL;
+        }
+
+        void STDMETHODCALLTYPE GetResourceTiling(ID3D12Resource*, UINT* pNumTilesForEntireResource, D3D12_PACKED_MIP_INFO* pPackedMipDesc, D3D12_TILE_SHAPE* pStandardTileShapeForNonPackedMips, UINT* pNumSubresourceTilings, UINT, D3D12_SUBRESOURCE_TILING*) override
+        {
+            if (pNumTilesForEntireResource)
+                *pNumTilesForEntireResource = 0;
+            if (pPackedMipDesc)
+                *pPackedMipDesc = {};
+            if (pStandardTileShapeForNonPackedMips)
+                *pStandardTileShapeForNonPackedMips = {};
+            if (pNumSubresourceTilings)
+                *pNumSubresourceTilings = 0;
+        }
+
+    #if defined(_MSC_VER) || !defined(_WIN32)
+        LUID STDMETHODCALLTYPE GetAdapterLuid() override { return LUID{}; }
+    #else
+        LUID* STDMETHODCALLTYPE GetAdapterLuid(LUID* RetVal) override { *RetVal = LUID{}; return RetVal; }
+    #endif
+
+    private:
+        std::atomic<size_t> mResources;
+        std::atomic<size_t> mResourceBytes;
+        std::atomic<size_t> mExecutions;
+        std::atomic<size_t> mDraws;
+        std::atomic<size_t> mInstances;
+        std::atomic<size_t> mDispatches;
+        std::atomic<size_t> mBarriers;
+        std::atomic<size_t> mBarrierCalls;
+        std::atomic<size_t> mCopies;
+        std::atomic<size_t> mBytesCopied;
+
+        HRESULT CreateResource(
+            const D3D12_HEAP_PROPERTIES& heapProperties,
+            D3D12_HEAP_FLAGS heapFlags,
+            const D3D12_RESOURCE_DESC* pDesc,
+            REFIID riid,
+            void** ppvResource) noexcept
+        {
+            if (ppvResource)
+                *ppvResource = nullptr;
+
+            if (!pDesc)
+                return E_INVALIDARG;
+
+            auto resource = new (std::nothrow) MockResource(this, *pDesc, heapProperties, heapFlags);
+            if (!resource)
+                return E_OUTOFMEMORY;
+
+            const HRESULT hr = resource->Initialize();
+            if (FAILED(hr))
+            {
+                resource->Release();
+                return hr;
+            }
+
+            ++mResources;
+            mResourceBytes += resource->Size();
+
+            return ReturnObject(resource, riid, ppvResource);
+        }
+
+        D3D12_RESOURCE_ALLOCATION_INFO AllocationInfo(UINT numResourceDescs, const D3D12_RESOURCE_DESC* pResourceDescs) const noexcept
+        {
+            D3D12_RESOURCE_ALLOCATION_INFO info = { 0, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT };
+
+            for (UINT i = 0; i < numResourceDescs; ++i)
+            {
+                const auto& desc = pResourceDescs[i];
+
+                UINT64 totalBytes = 0;
+                GetFootprints(desc, 0, SubresourceCount(desc), 0, nullptr, nullptr, nullptr, &totalBytes);
+                if (totalBytes == UINT64(-1))
+                {
+                    info.SizeInBytes = UINT64(-1);
+                    return info;
+                }
+
+                UINT64 alignment = desc.Alignment;
+                if (!alignment)
+                {
+                    alignment = (desc.SampleDesc.Count > 1) ? D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+                }
+
+                info.Alignment = std::max(info.Alignment, alignment);
+                info.SizeInBytes = AlignUp(info.SizeInBytes, alignment) + AlignUp(totalBytes, alignment);
+            }
+
+            return info;
+        }
+
+        static D3D12_HEAP_PROPERTIES CustomHeapProperties(UINT nodeMask, D3D12_HEAP_TYPE heapType) noexcept
+        {
+            D3D12_HEAP_PROPERTIES props = {};
+            props.Type = D3D12_HEAP_TYPE_CUSTOM;
+            props.CPUPageProperty = (heapType == D3D12_HEAP_TYPE_DEFAULT) ? D3D12_CPU_PAGE_PROPERTY_NOT_AVAILABLE
+                : (heapType == D3D12_HEAP_TYPE_READBACK) ? D3D12_CPU_PAGE_PROPERTY_WRITE_BACK
+                : D3D12_CPU_PAGE_PROPERTY_WRITE_COMBINE;
+            props.MemoryPoolPreference = D3D12_MEMORY_POOL_L0;
+            props.CreationNodeMask = nodeMask ? nodeMask : 1u;
+            props.VisibleNodeMask = props.CreationNodeMask;
+            return props;
+        }
+    };
+
+    template<typename Base>
+    MockDevice* MockDeviceChild<Base>::Device() const noexcept
+    {
+        return static_cast<MockDevice*>(mDevice);
+    }
+
+    //----------------------------------------------------------------------------------
+    HRESULT STDMETHODCALLTYPE MockDevice::CheckFeatureSupport(D3D12_FEATURE Feature, void* pFeatureSupportData, UINT FeatureSupportDataSize)
+    {
+        if (!pFeatureSupportData)
+            return E_INVALIDARG;
+
+        switch (Feature)
+        {
+        case D3D12_FEATURE_D3D12_OPTIONS:
+            if (FeatureSupportDataSize != sizeof(D3D12_FEATURE_DATA_D3D12_OPTIONS))
+                return E_INVALIDARG;
+            {
+                auto options = static_cast<D3D12_FEATURE_DATA_D3D12_OPTIONS*>(pFeatureSupportData);
+                *options = {};
+                options->TypedUAVLoadAdditionalFormats = TRUE;
+                options->ResourceBindingTier = D3D12_RESOURCE_BINDING_TIER_3;
+                options->TiledResourcesTier = D3D12_TILED_RESOURCES_TIER_NOT_SUPPORTED;
+                options->ResourceHeapTier = D3D12_RESOURCE_HEAP_TIER_2;
+            }
+            return S_OK;
+
+        case D3D12_FEATURE_FORMAT_SUPPORT:
+            if (FeatureSupportDataSize != sizeof(D3D12_FEATURE_DATA_FORMAT_SUPPORT))
+                return E_INVALIDARG;
+            {
+                // Every format is treated as fully supported
+                auto support = static_cast<D3D12_FEATURE_DATA_FORMAT_SUPPORT*>(pFeatureSupportData);
+                support->Support1 = D3D12_FORMAT_SUPPORT1_BUFFER
+                    | D3D12_FORMAT_SUPPORT1_IA_VERTEX_BUFFER
+                    | D3D12_FORMAT_SUPPORT1_IA_INDEX_BUFFER
+                    | D3D12_FORMAT_SUPPORT1_TEXTURE2D
+                    | D3D12_FORMAT_SUPPORT1_TEXTURE3D
+                    | D3D12_FORMAT_SUPPORT1_TEXTURECUBE
+                    | D3D12_FORMAT_SUPPORT1_SHADER_LOAD
+                    | D3D12_FORMAT_SUPPORT1_SHADER_SAMPLE
+                    | D3D12_FORMAT_SUPPORT1_MIP
+                    | D3D12_FORMAT_SUPPORT1_RENDER_TARGET
+                    | D3D12_FORMAT_SUPPORT1_BLENDABLE
+                    | D3D12_FORMAT_SUPPORT1_TYPED_UNORDERED_ACCESS_VIEW;
+                support->Support2 = D3D12_FORMAT_SUPPORT2_UAV_TYPED_LOAD
+                    | D3D12_FORMAT_SUPPORT2_UAV_TYPED_STORE;
+            }
+            return S_OK;
+
+        case D3D12_FEATURE_FORMAT_INFO:
+            if (FeatureSupportDataSize != sizeof(D3D12_FEATURE_DATA_FORMAT_INFO))
+                return E_INVALIDARG;
+
+            static_cast<D3D12_FEATURE_DATA_FORMAT_INFO*>(pFeatureSupportData)->PlaneCount = 1;
+            return S_OK;
+
+        case D3D12_FEATURE_ROOT_SIGNATURE:
+            if (FeatureSupportDataSize != sizeof(D3D12_FEATURE_DATA_ROOT_SIGNATURE))
+                return E_INVALIDARG;
+            {
+                auto rootSig = static_cast<D3D12_FEATURE_DATA_ROOT_SIGNATURE*>(pFeatureSupportData);
+                rootSig->HighestVersion = std::min(rootSig->HighestVersion, D3D_ROOT_SIGNATURE_VERSION_1_1);
+            }
+            return S_OK;
+
+        case D3D12_FEATURE_SHADER_MODEL:
+            if (FeatureSupportDataSize != sizeof(D3D12_FEATURE_DATA_SHADER_MODEL))
+                return E_INVALIDARG;
+            {
+                auto shaderModel = static_cast<D3D12_FEATURE_DATA_SHADER_MODEL*>(pFeatureSupportData);
+                shaderModel->HighestShaderModel = std::min(shaderModel->HighestShaderModel, D3D_SHADER_MODEL_6_0);
+            }
+            return S_OK;
+
+        default:
+            return E_INVALIDARG;
+        }
+    }
+
+    //----------------------------------------------------------------------------------
+    void MockCommandList::Execute(Statistics& stats) const noexcept
+    {
+        stats = mStats;
+
+        for (const auto& copy : mCopies)
+        {
+            auto dst = static_cast<MockResource*>(copy.dst.pResource);
+            auto src = static_cast<MockResource*>(copy.src.pResource);
+            if (!dst || !src)
+                continue;
+
+            size_t bytes = 0;
+            switch (copy.type)
+            {
+            case CopyType::Buffer:
+                if (copy.dstOffset + copy.bytes <= dst->Size() && copy.srcOffset + copy.bytes <= src->Size())
+                {
+                    bytes = static_cast<size_t>(copy.bytes);
+                    memcpy(dst->Data() + copy.dstOffset, src->Data() + copy.srcOffset, bytes);
+                }
+                break;
+
+            case CopyType::Resource:
+                bytes = std::min(dst->Size(), src->Size());
+                memcpy(dst->Data(), src->Data(), bytes);
+                break;
+
+            case CopyType::Texture:
+            {
+                // Resolve both ends to a footprint in their resource's memory
+                auto locate = [](const D3D12_TEXTURE_COPY_LOCATION& location, MockResource* resource,
+                    D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint) noexcept -> bool
+                    {
+                        if (location.Type == D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT)
+                        {
+                            footprint = location.PlacedFootprint;
+                            return true;
+                        }
+
+                        if (location.SubresourceIndex >= resource->Subresources())
+                            return false;
+
+                        footprint = resource->Layout(location.SubresourceIndex);
+                        return true;
+                    };
+
+                D3D12_PLACED_SUBRESOURCE_FOOTPRINT dstFootprint, srcFootprint;
+                if (!locate(copy.dst, dst, dstFootprint) || !locate(copy.src, src, srcFootprint))
+                    break;
+
+                D3D12_RESOURCE_DESC desc = {};
+                desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+                desc.Width = srcFootprint.Footprint.Width;
+                desc.Height = srcFootprint.Footprint.Height;
+                desc.DepthOrArraySize = 1;
+                desc.MipLevels = 1;
+                desc.Format = srcFootprint.Footprint.Format;
+
+                UINT rows = 0;
+                UINT64 rowSize = 0;
+                GetFootprints(desc, 0, 1, 0, nullptr, &rows, &rowSize, nullptr);
+
+                const UINT depth = std::min(srcFootprint.Footprint.Depth, dstFootprint.Footprint.Depth);
+                const UINT64 dstEnd = dstFootprint.Offset + UINT64(dstFootprint.Footprint.RowPitch) * (UINT64(rows) * depth - 1) + rowSize;
+                const UINT64 srcEnd = srcFootprint.Offset + UINT64(srcFootprint.Footprint.RowPitch) * (UINT64(rows) * depth - 1) + rowSize;
+                if (dstEnd > dst->Size() || srcEnd > src->Size() || rowSize > dstFootprint.Footprint.RowPitch)
+                    break;
+
+                for (UINT y = 0; y < rows * depth; ++y)
+                {
+                    memcpy(dst->Data() + dstFootprint.Offset + UINT64(dstFootprint.Footprint.RowPitch) * y,
+                        src->Data() + srcFootprint.Offset + UINT64(srcFootprint.Footprint.RowPitch) * y,
+                        static_cast<size_t>(rowSize));
+                }
+                bytes = static_cast<size_t>(rowSize * rows * depth);
+                break;
+            }
+            }
+
+            ++stats.copies;
+            stats.bytesCopied += bytes;
+        }
+    }
+
+    void STDMETHODCALLTYPE MockCommandQueue::ExecuteCommandLists(UINT NumCommandLists, ID3D12CommandList* const* ppCommandLists)
+    {
+        for (UINT i = 0; i < NumCommandLists; ++i)
+        {
+            // Every command list comes from a mock device, which only creates graphics command lists
+            auto list = static_cast<MockCommandList*>(static_cast<ID3D12GraphicsCommandList*>(ppCommandLists[i]));
+
+            Statistics stats = {};
+            list->Execute(stats);
+            Device()->AddExecution(stats);
+        }
+    }
+}
+
+
+_Use_decl_annotations_
+HRESULT MockD3D12::CreateDevice(ID3D12Device** device) noexcept
+{
+    if (!device)
+        return E_INVALIDARG;
+
+    *device = new (std::nothrow) MockDevice;
+    return *device ? S_OK : E_OUTOFMEMORY;
+}
+
+
+_Use_decl_annotations_
+Statistics MockD3D12::GetStatistics(ID3D12Device* device) noexcept
+{
+    return static_cast<MockDevice*>(device)->GetStatistics();
+}
+
+
+_Use_decl_annotations_
+HRESULT MockD3D12::SetFrameLatency(ID3D12CommandQueue* queue, size_t frames) noexcept
+{
+    if (!queue)
+        return E_INVALIDARG;
+
+    return static_cast<MockCommandQueue*>(queue)->SetFrameLatency(frames);
+}
+
+
+_Use_decl_annotations_
+HRESULT MockD3D12::EndFrame(ID3D12CommandQueue* queue) noexcept
+{
+    if (!queue)
+        return E_INVALIDARG;
+
+    return static_cast<MockCommandQueue*>(queue)->EndFrame();
+}
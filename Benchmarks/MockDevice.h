@@ -0,0 +1,61 @@
+//--------------------------------------------------------------------------------------
+// File: MockDevice.h
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//
+// https://go.microsoft.com/fwlink/?LinkID=615561
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#ifdef USING_DIRECTX_HEADERS
+#include <directx/d3d12.h>
+#include <dxguids/dxguids.h>
+#else
+#include <d3d12.h>
+#endif
+
+#include <cstddef>
+
+
+// A Direct3D 12 device, command queue and command list backed by host memory, so the
+// toolkit's CPU paths can be exercised and timed without a GPU. Command lists execute
+// synchronously in ExecuteCommandLists and fences complete as soon as they are signaled,
+// unless SetFrameLatency holds the signals back.
+namespace MockD3D12
+{
+    // Work seen by a mock device since it was created.
+    struct Statistics
+    {
+        size_t resources;           // Resources created
+        size_t resourceBytes;       // Host memory allocated for those resources
+        size_t executions;          // Command lists executed
+        size_t draws;               // DrawInstanced and DrawIndexedInstanced calls
+        size_t instances;           // Instances drawn by those calls
+        size_t dispatches;          // Dispatch calls
+        size_t barriers;            // Barriers recorded
+        size_t barrierCalls;        // ResourceBarrier calls
+        size_t copies;              // Copy commands executed
+        size_t bytesCopied;         // Bytes written by those copies
+    };
+
+    // Creates a device that backs every resource with host memory. Buffers have a CPU
+    // pointer for their GPU virtual address, and textures use the same linear layout
+    // GetCopyableFootprints reports. Placed resources get memory of their own, so
+    // aliasing through a heap is not modeled.
+    HRESULT CreateDevice(_COM_Outptr_ ID3D12Device** device) noexcept;
+
+    // The device must have been created by CreateDevice.
+    Statistics GetStatistics(_In_ ID3D12Device* device) noexcept;
+
+    // Models a GPU running behind the CPU by holding back the fence signals made on a
+    // queue. Signals made during a frame complete once the given number of later frames
+    // have been ended with EndFrame. Zero, the default, completes every held signal and
+    // goes back to completing them immediately; set it before anything waits on a fence
+    // signaled by the queue, as held signals otherwise never complete.
+    HRESULT SetFrameLatency(_In_ ID3D12CommandQueue* queue, size_t frames) noexcept;
+
+    // Ends the current frame of held signals. The queue must have come from a mock device.
+    HRESULT EndFrame(_In_ ID3D12CommandQueue* queue) noexcept;
+}
@@ -0,0 +1,107 @@
+//--------------------------------------------------------------------------------------
+// File: ResourceUploadBenchmarks.cpp
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//
+// https://go.microsoft.com/fwlink/?LinkID=615561
+//--------------------------------------------------------------------------------------
+
+#include "Benchmarks.h"
+
+#include "ResourceUploadBatch.h"
+
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+using namespace Benchmarks;
+using namespace DirectX;
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    constexpr size_t c_TextureCount = 64;
+    constexpr UINT c_TextureSize = 256;
+    constexpr size_t c_Iterations = 100;
+}
+
+
+void Benchmarks::RunUploadBenchmarks(const Context& context)
+{
+    auto device = context.device.Get();
+    auto queue = context.queue.Get();
+
+    D3D12_RESOURCE_DESC desc = {};
+    desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    desc.Width = c_TextureSize;
+    desc.Height = c_TextureSize;
+    desc.DepthOrArraySize = 1;
+    desc.MipLevels = 1;
+    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    desc.SampleDesc.Count = 1;
+
+    D3D12_HEAP_PROPERTIES heapProperties = {};
+    heapProperties.Type = D3D12_HEAP_TYPE_DEFAULT;
+
+    std::vector<ComPtr<ID3D12Resource>> textures(c_TextureCount);
+    for (auto& texture : textures)
+    {
+        ThrowIfFailed(device->CreateCommittedResource(&heapProperties, D3D12_HEAP_FLAG_NONE, &desc,
+            D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(texture.GetAddressOf())));
+    }
+
+    // Every texture gets different contents, so the upload cache only hits on repeats
+    const size_t rowPitch = size_t(c_TextureSize) * sizeof(uint32_t);
+    std::vector<uint32_t> pixels(size_t(c_TextureSize) * c_TextureSize * c_TextureCount);
+    for (size_t j = 0; j < pixels.size(); ++j)
+    {
+        pixels[j] = static_cast<uint32_t>(j * 2654435761u);
+    }
+
+    std::vector<D3D12_SUBRESOURCE_DATA> subresources(c_TextureCount);
+    std::vector<ResourceUploadDesc> uploads(c_TextureCount);
+    for (size_t j = 0; j < c_TextureCount; ++j)
+    {
+        subresources[j].pData = &pixels[j * c_TextureSize * c_TextureSize];
+        subresources[j].RowPitch = static_cast<LONG_PTR>(rowPitch);
+        subresources[j].SlicePitch = static_cast<LONG_PTR>(rowPitch * c_TextureSize);
+
+        uploads[j] = { textures[j].Get(), 0, &subresources[j], 1 };
+    }
+
+    ResourceUploadBatch batch(device);
+
+    Measure("Upload, one call per texture", c_Iterations, [&](size_t)
+        {
+            batch.Begin();
+            for (size_t j = 0; j < c_TextureCount; ++j)
+            {
+                batch.Upload(textures[j].Get(), 0, &subresources[j], 1);
+            }
+            batch.End(queue).wait();
+        });
+
+    Measure("Upload, one batched call", c_Iterations, [&](size_t)
+        {
+            batch.Begin();
+            batch.Upload(uploads.data(), uploads.size());
+            batch.End(queue).wait();
+        });
+
+    std::vector<ComPtr<ID3D12Resource>> cached(c_TextureCount);
+    batch.SetUploadCacheEnabled(true);
+
+    Measure("UploadCached, hits after the first pass", c_Iterations, [&](size_t)
+        {
+            batch.Begin();
+            for (size_t j = 0; j < c_TextureCount; ++j)
+            {
+                std::ignore = batch.UploadCached(desc, &subresources[j], 1,
+                    D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, cached[j].ReleaseAndGetAddressOf());
+            }
+            batch.End(queue).wait();
+        });
+
+    batch.SetUploadCacheEnabled(false);
+}
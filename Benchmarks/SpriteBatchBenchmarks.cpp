@@ -0,0 +1,188 @@
+//--------------------------------------------------------------------------------------
+// File: SpriteBatchBenchmarks.cpp
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//
+// https://go.microsoft.com/fwlink/?LinkID=615561
+//--------------------------------------------------------------------------------------
+
+#include "Benchmarks.h"
+
+#include "BenchmarkHooks.h"
+#include "GraphicsMemory.h"
+#include "RenderTargetState.h"
+#include "ResourceUploadBatch.h"
+#include "SpriteBatch.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using namespace Benchmarks;
+using namespace DirectX;
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+    constexpr size_t c_SpriteCounts[] = { 1000, 10000, 100000 };
+    constexpr size_t c_TextureCount = 16;
+    constexpr UINT c_TextureSize = 64;
+    constexpr size_t c_Frames = 20;
+
+    struct SortCase
+    {
+        const char* name;
+        SpriteSortMode mode;
+    };
+
+    const SortCase c_SortCases[] =
+    {
+        { "back to front", SpriteSortMode_BackToFront },
+        { "texture", SpriteSortMode_Texture },
+    };
+
+    struct Sprite
+    {
+        XMFLOAT2 position;
+        float rotation;
+        float depth;
+        size_t texture;
+    };
+
+    // Sprites are spread over the screen with varying rotation and depth, so every vertex
+    // path does its full transform and the depth sorts have real work to do
+    std::vector<Sprite> CreateSprites(size_t count)
+    {
+        std::vector<Sprite> sprites(count);
+
+        uint32_t seed = 12345;
+        auto random = [&seed]() noexcept
+            {
+                seed = seed * 1664525u + 1013904223u;
+                return float(seed >> 8) / float(1u << 24);
+            };
+
+        for (auto& sprite : sprites)
+        {
+            sprite.position = XMFLOAT2(random() * 1920.f, random() * 1080.f);
+            sprite.rotation = random() * XM_2PI;
+            sprite.depth = random();
+            sprite.texture = size_t(random() * c_TextureCount) % c_TextureCount;
+        }
+
+        return sprites;
+    }
+
+    // Records a command list for the mock device, executing it at the end of each frame
+    struct FrameRecorder
+    {
+        ComPtr<ID3D12CommandAllocator>      allocator;
+        ComPtr<ID3D12GraphicsCommandList>   commandList;
+
+        explicit FrameRecorder(ID3D12Device* device)
+        {
+            ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(allocator.GetAddressOf())));
+            ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, allocator.Get(), nullptr,
+                IID_PPV_ARGS(commandList.GetAddressOf())));
+        }
+
+        void Submit(ID3D12CommandQueue* queue, GraphicsMemory& graphicsMemory)
+        {
+            ThrowIfFailed(commandList->Close());
+
+            ID3D12CommandList* lists[] = { commandList.Get() };
+            queue->ExecuteCommandLists(1, lists);
+
+            graphicsMemory.Commit(queue);
+
+            ThrowIfFailed(allocator->Reset());
+            ThrowIfFailed(commandList->Reset(allocator.Get(), nullptr));
+        }
+    };
+
+    std::unique_ptr<SpriteBatch> CreateSpriteBatch(const Context& context, bool instanced)
+    {
+        const RenderTargetState rtState(DXGI_FORMAT_B8G8R8A8_UNORM, DXGI_FORMAT_D32_FLOAT);
+
+        SpriteBatchPipelineStateDescription pd(rtState);
+        pd.instanced = instanced;
+
+        const D3D12_VIEWPORT viewport = { 0.f, 0.f, 1920.f, 1080.f, D3D12_MIN_DEPTH, D3D12_MAX_DEPTH };
+
+        ResourceUploadBatch upload(context.device.Get());
+        upload.Begin();
+
+        auto spriteBatch = std::make_unique<SpriteBatch>(context.device.Get(), upload, pd, &viewport);
+
+        upload.End(context.queue.Get()).wait();
+
+        return spriteBatch;
+    }
+
+    // Times whole frames of Begin, Draw for every sprite, and End, and reports sprite throughput
+    void MeasureSprites(const char* name, const Context& context, GraphicsMemory& graphicsMemory,
+        SpriteBatch& spriteBatch, FrameRecorder& recorder, const std::vector<Sprite>& sprites, SpriteSortMode sortMode)
+    {
+        const XMUINT2 textureSize(c_TextureSize, c_TextureSize);
+        const XMFLOAT2 origin(c_TextureSize * 0.5f, c_TextureSize * 0.5f);
+
+        const double frame = Measure(name, c_Frames, [&](size_t)
+            {
+                spriteBatch.Begin(recorder.commandList.Get(), sortMode);
+
+                for (const auto& sprite : sprites)
+                {
+                    // Any non-null handle will do, as the mock device never reads descriptors
+                    const D3D12_GPU_DESCRIPTOR_HANDLE texture = { UINT64(sprite.texture + 1) * 64 };
+
+                    spriteBatch.Draw(texture, textureSize, sprite.position, nullptr,
+                        Colors::White, sprite.rotation, origin, 1.f, SpriteEffects_None, sprite.depth);
+                }
+
+                spriteBatch.End();
+
+                recorder.Submit(context.queue.Get(), graphicsMemory);
+            });
+
+        printf("  %-48s %12.1f\n", "  sprites per millisecond", double(sprites.size()) * 1000. / frame);
+    }
+}
+
+
+void Benchmarks::RunSpriteBatchBenchmarks(const Context& context)
+{
+    GraphicsMemory graphicsMemory(context.device.Get());
+    FrameRecorder recorder(context.device.Get());
+
+    auto vertexBatch = CreateSpriteBatch(context, false);
+    auto instancedBatch = CreateSpriteBatch(context, true);
+
+    for (const size_t count : c_SpriteCounts)
+    {
+        const auto sprites = CreateSprites(count);
+
+        char name[64] = {};
+        snprintf(name, sizeof(name), "%zu sprites, vertices one sprite at a time", count);
+        BenchmarkHooks::SetSpriteBatchScalarVertices(true);
+        MeasureSprites(name, context, graphicsMemory, *vertexBatch, recorder, sprites, SpriteSortMode_Deferred);
+        BenchmarkHooks::SetSpriteBatchScalarVertices(false);
+
+        snprintf(name, sizeof(name), "%zu sprites, vertices four sprites at a time", count);
+        MeasureSprites(name, context, graphicsMemory, *vertexBatch, recorder, sprites, SpriteSortMode_Deferred);
+
+        snprintf(name, sizeof(name), "%zu sprites, instanced", count);
+        MeasureSprites(name, context, graphicsMemory, *instancedBatch, recorder, sprites, SpriteSortMode_Deferred);
+
+        for (const auto& sort : c_SortCases)
+        {
+            snprintf(name, sizeof(name), "%zu sprites, %s, std::sort", count, sort.name);
+            BenchmarkHooks::SetSpriteBatchComparisonSort(true);
+            MeasureSprites(name, context, graphicsMemory, *vertexBatch, recorder, sprites, sort.mode);
+            BenchmarkHooks::SetSpriteBatchComparisonSort(false);
+
+            snprintf(name, sizeof(name), "%zu sprites, %s, radix sort", count, sort.name);
+            MeasureSprites(name, context, graphicsMemory, *vertexBatch, recorder, sprites, sort.mode);
+        }
+    }
+}
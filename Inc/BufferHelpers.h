@@ -47,6 +47,8 @@ namespace DirectX
     class ResourceUploadBatch;
 
     // Helpers for creating initialized Direct3D buffer resources.
+    // While resourceUpload's upload cache is enabled, CreateStaticBuffer creates the buffer on the
+    // batch's device and may return one shared with an earlier call with the same data.
     DIRECTX_TOOLKIT_API
         HRESULT __cdecl CreateStaticBuffer(
             _In_ ID3D12Device* device,
@@ -124,6 +126,8 @@ namespace DirectX
     }
 
     // Helpers for creating texture from memory arrays.
+    // While resourceUpload's upload cache is enabled, the texture is created on the batch's device
+    // and may be shared with an earlier call with the same data.
     DIRECTX_TOOLKIT_API
         HRESULT __cdecl CreateTextureFromMemory(
             _In_ ID3D12Device* device,
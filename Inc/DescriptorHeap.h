@@ -20,11 +20,16 @@
 #include <d3d12.h>
 #endif
 
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <stdexcept>
+#include <utility>
 
 #include <wrl/client.h>
 
@@ -159,8 +164,22 @@ namespace DirectX
     };
 
 
+    // Fragmentation of a DescriptorPile. Freed descriptors below top are available
+    // again, but a request larger than largestFreeRange has to be placed above top.
+    struct DescriptorPileStatistics
+    {
+        size_t allocated;           // Descriptors in use, including the reserved range
+        size_t top;                 // One past the highest descriptor in use
+        size_t freeDescriptors;     // Freed descriptors below top
+        size_t freeRanges;          // Number of separate freed ranges below top
+        size_t largestFreeRange;    // Longest freed range below top
+    };
+
     // Helper class for dynamically allocating descriptor indices.
     // The pile is statically sized and will throw an exception if it becomes full.
+    // Ranges returned with Free are reused by later allocations. Allocation and
+    // Free are thread safe, and while no freed range is available allocation is
+    // a lock-free bump of the top index.
     class DescriptorPile : public DescriptorHeap
     {
     public:
@@ -171,9 +190,9 @@ namespace DirectX
             _In_ ID3D12DescriptorHeap* pExistingHeap,
             size_t reserve = 0)
             : DescriptorHeap(pExistingHeap),
-            m_top(reserve)
+            m_state(std::make_unique<State>(reserve))
         {
-            if (reserve > 0 && m_top >= Count())
+            if (reserve > 0 && reserve >= Count())
             {
                 throw std::out_of_range("Reserve descriptor range is too large");
             }
@@ -184,9 +203,9 @@ namespace DirectX
             _In_ const D3D12_DESCRIPTOR_HEAP_DESC* pDesc,
             size_t reserve = 0)
             : DescriptorHeap(device, pDesc),
-            m_top(reserve)
+            m_state(std::make_unique<State>(reserve))
         {
-            if (reserve > 0 && m_top >= Count())
+            if (reserve > 0 && reserve >= Count())
             {
                 throw std::out_of_range("Reserve descriptor range is too large");
             }
@@ -199,9 +218,9 @@ namespace DirectX
             size_t capacity,
             size_t reserve = 0)
             : DescriptorHeap(device, type, flags, capacity),
-            m_top(reserve)
+            m_state(std::make_unique<State>(reserve))
         {
-            if (reserve > 0 && m_top >= Count())
+            if (reserve > 0 && reserve >= Count())
             {
                 throw std::out_of_range("Reserve descriptor range is too large");
             }
@@ -232,7 +251,144 @@ namespace DirectX
 
         DIRECTX_TOOLKIT_API void AllocateRange(size_t numDescriptors, _Out_ IndexType& start, _Out_ IndexType& end);
 
+        // Returns a range from Allocate or AllocateRange to the pile. It may be freed in
+        // smaller pieces than it was allocated in.
+        DIRECTX_TOOLKIT_API void Free(IndexType start, size_t numDescriptors);
+
+        DIRECTX_TOOLKIT_API DescriptorPileStatistics GetStatistics() const;
+
+    private:
+        // Held by pointer so the pile stays movable
+        struct State
+        {
+            std::atomic<IndexType>                  top;
+            std::atomic<size_t>                     freeRangeCount; // Read without the lock
+            std::mutex                              mutex;          // Guards the freed ranges
+            std::map<IndexType, size_t>             freeRanges;     // Start and length of each freed range
+            std::set<std::pair<size_t, IndexType>>  freeBySize;     // The same ranges ordered for best fit
+
+            explicit State(IndexType reserve) noexcept : top(reserve), freeRangeCount(0) {}
+        };
+
+        std::unique_ptr<State> m_state;
+
+        IndexType AllocateFromTop(size_t numDescriptors);
+        void InsertFreeRange(IndexType start, size_t numDescriptors);
+        void EraseFreeRange(std::map<IndexType, size_t>::iterator it);
+    };
+
+
+    // Hands out descriptors from chunks allocated from a DescriptorPile, so a loader
+    // thread only touches the shared pile once per chunk. The unused part of the
+    // current chunk is returned to the pile on destruction.
+    //
+    // This class is NOT thread safe. Use one per thread.
+    class DescriptorPileCache
+    {
+    public:
+        using IndexType = DescriptorPile::IndexType;
+
+        explicit DescriptorPileCache(DescriptorPile& pile, size_t chunkSize = 64) noexcept
+            : m_pile(&pile),
+            m_chunkSize(chunkSize > 0 ? chunkSize : 1),
+            m_next(0),
+            m_end(0)
+        {}
+
+        DescriptorPileCache(DescriptorPileCache&&) = delete;
+        DescriptorPileCache& operator=(DescriptorPileCache&&) = delete;
+
+        DescriptorPileCache(const DescriptorPileCache&) = delete;
+        DescriptorPileCache& operator=(const DescriptorPileCache&) = delete;
+
+        ~DescriptorPileCache()
+        {
+            Release();
+        }
+
+        IndexType Allocate()
+        {
+            if (m_next == m_end)
+            {
+                m_pile->AllocateRange(m_chunkSize, m_next, m_end);
+            }
+
+            return m_next++;
+        }
+
+        // Returns the unused part of the current chunk to the pile
+        void Release() noexcept
+        {
+            if (m_next != m_end)
+            {
+                try
+                {
+                    m_pile->Free(m_next, m_end - m_next);
+                }
+                catch (...)
+                {
+                }
+            }
+
+            m_next = m_end = 0;
+        }
+
+    private:
+        DescriptorPile* m_pile;
+        size_t          m_chunkSize;
+        IndexType       m_next;
+        IndexType       m_end;
+    };
+
+
+    // A shader visible descriptor heap used as a ring for transient descriptors. Stage
+    // copies descriptors from non shader visible heaps into a contiguous range, which
+    // stays valid until the GPU has finished the frame it was staged in.
+    //
+    // The copies are batched into a single CopyDescriptors call by Flush, which must be
+    // called before executing the command lists that use them. Commit marks the end of
+    // a frame: call it after executing those command lists on the queue.
+    //
+    // This class is NOT thread safe.
+    class DescriptorRing
+    {
+    public:
+        DIRECTX_TOOLKIT_API DescriptorRing(
+            _In_ ID3D12Device* device,
+            D3D12_DESCRIPTOR_HEAP_TYPE type,
+            size_t count);
+
+        DIRECTX_TOOLKIT_API DescriptorRing(DescriptorRing&&) noexcept;
+        DIRECTX_TOOLKIT_API DescriptorRing& operator=(DescriptorRing&&) noexcept;
+
+        DescriptorRing(const DescriptorRing&) = delete;
+        DescriptorRing& operator=(const DescriptorRing&) = delete;
+
+        DIRECTX_TOOLKIT_API ~DescriptorRing();
+
+        // Returns the GPU handle of the first staged descriptor. If the ring is full, this
+        // blocks until the GPU finishes the oldest committed frame.
+        DIRECTX_TOOLKIT_API D3D12_GPU_DESCRIPTOR_HANDLE __cdecl Stage(
+            _In_reads_(descriptorCount) const D3D12_CPU_DESCRIPTOR_HANDLE* pDescriptors,
+            uint32_t descriptorCount);
+
+        // Issues the pending copies
+        DIRECTX_TOOLKIT_API void __cdecl Flush();
+
+        // Flushes, then fences everything staged since the last Commit
+        DIRECTX_TOOLKIT_API void __cdecl Commit(_In_ ID3D12CommandQueue* commandQueue);
+
+        DIRECTX_TOOLKIT_API ID3D12DescriptorHeap* __cdecl Heap() const noexcept;
+
+        // Statistics
+        DIRECTX_TOOLKIT_API size_t __cdecl InUseCount() const noexcept;
+        DIRECTX_TOOLKIT_API size_t __cdecl CopyCallCount() const noexcept;
+        DIRECTX_TOOLKIT_API size_t __cdecl StallCount() const noexcept;
+
     private:
-        IndexType m_top;
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
     };
 }
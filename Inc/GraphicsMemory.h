@@ -24,6 +24,7 @@
 #include <cstdint>
 #include <cstring>
 #include <memory>
+#include <vector>
 
 #ifdef _GAMING_XBOX
 #include <gxdk.h>
@@ -148,14 +149,69 @@ namespace DirectX
         };
 
         //------------------------------------------------------------------------------
+        struct GraphicsMemorySizeClassStatistics
+        {
+            size_t allocationSize;      // Slot size in bytes for this class
+            size_t usedMemory;          // Bytes requested from pages currently in use or in-flight
+            size_t wastedMemory;        // Bytes of those pages lost to slot rounding or left unused
+            size_t totalPages;          // Total page count, including ring buffer chunks
+        };
+
+        struct GraphicsMemoryUsageStatistics
+        {
+            size_t allocatedMemory;     // Bytes requested
+            size_t allocationCount;     // Number of allocations
+        };
+
         struct GraphicsMemoryStatistics
         {
+            // Small allocations are packed into 256, 512, 1024, and 2048 byte slots
+            static constexpr size_t SizeClassCount = 4;
+
+            // Allocations are counted by GraphicsMemory::Tag; larger tag values are counted as TAG_GENERIC
+            static constexpr size_t TagCount = 8;
+
+            // 21 power of 2 page pools (64KB pages up to 2GB), the 4 size class pools, and the ring buffer
+            static constexpr size_t PoolCount = 26;
+
             size_t committedMemory;     // Bytes of memory currently committed/in-flight
             size_t totalMemory;         // Total bytes of memory used by the allocators
-            size_t totalPages;          // Total page count
+            size_t totalPages;          // Total page count, including ring buffer chunks
             size_t peakCommitedMemory;  // Peak commited memory value since last reset
             size_t peakTotalMemory;     // Peak total bytes
             size_t peakTotalPages;      // Peak total page count
+            size_t ringBufferStalls;    // Times the GPU still had the next ring buffer chunk, so a page was used instead
+            size_t ringBufferFallbacks; // Times the ring buffer was exhausted and a page was used instead
+
+            GraphicsMemorySizeClassStatistics sizeClasses[SizeClassCount];
+
+            GraphicsMemoryUsageStatistics tags[TagCount];   // Requests by tag since last reset
+            GraphicsMemoryUsageStatistics pools[PoolCount]; // Requests by pool since last reset
+        };
+
+        struct GraphicsMemoryFrameStatistics
+        {
+            uint64_t frameIndex;        // Number of Commit calls before this frame
+            size_t committedMemory;     // Bytes of memory committed/in-flight at the end of the frame
+            size_t totalMemory;         // Total bytes of memory used by the allocators at the end of the frame
+            size_t totalPages;          // Total page count at the end of the frame
+
+            GraphicsMemoryUsageStatistics tags[GraphicsMemoryStatistics::TagCount];   // Requests by tag during the frame
+            GraphicsMemoryUsageStatistics pools[GraphicsMemoryStatistics::PoolCount]; // Requests by pool during the frame
+        };
+
+        //------------------------------------------------------------------------------
+        enum GRAPHICS_MEMORY_FLAGS : uint32_t
+        {
+            GRAPHICS_MEMORY_DEFAULT = 0,
+
+            // Serve small allocations from a single persistently mapped ring buffer
+            // with one fence per Commit, falling back to pages when it is exhausted.
+            GRAPHICS_MEMORY_RING_BUFFER = 0x1,
+
+            // Create small pages as placed resources in a few large upload heaps
+            // rather than as individual committed resources.
+            GRAPHICS_MEMORY_PLACED_PAGES = 0x2,
         };
 
         //------------------------------------------------------------------------------
@@ -173,7 +229,13 @@ namespace DirectX
                 TAG_COMPUTE,
             };
 
+            // With GRAPHICS_MEMORY_RING_BUFFER, requests whose size plus alignment is no more than
+            // this come from the ring buffer. Memory held for many frames should be larger, as a
+            // ring chunk cannot be reused until every allocation in it is released.
+            static constexpr size_t RingBufferAllocationLimit = 16 * 1024;
+
             DIRECTX_TOOLKIT_API explicit GraphicsMemory(_In_ ID3D12Device* device);
+            DIRECTX_TOOLKIT_API GraphicsMemory(_In_ ID3D12Device* device, GRAPHICS_MEMORY_FLAGS flags, size_t ringBufferSize = 0);
 
             DIRECTX_TOOLKIT_API GraphicsMemory(GraphicsMemory&&) noexcept;
             DIRECTX_TOOLKIT_API GraphicsMemory& operator= (GraphicsMemory&&) noexcept;
@@ -188,11 +250,9 @@ namespace DirectX
             // the GraphicsResource object, or your memory may be overwritten later.
             DIRECTX_TOOLKIT_API inline GraphicsResource __cdecl Allocate(size_t size, size_t alignment = 16, uint32_t tag = TAG_GENERIC)
             {
-                auto alloc = AllocateImpl(size, alignment);
+                auto alloc = AllocateImpl(size, alignment, tag);
             #ifdef USING_PIX_CUSTOM_MEMORY_EVENTS
                 std::ignore = ReportCustomMemoryAlloc(alloc.Memory(), alloc.Size(), tag);
-            #else
-                UNREFERENCED_PARAMETER(tag);
             #endif
                 return alloc;
             }
@@ -202,7 +262,7 @@ namespace DirectX
             {
                 constexpr size_t alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
                 constexpr size_t alignedSize = (sizeof(T) + alignment - 1) & ~(alignment - 1);
-                auto alloc = AllocateImpl(alignedSize, alignment);
+                auto alloc = AllocateImpl(alignedSize, alignment, TAG_CONSTANT);
             #ifdef USING_PIX_CUSTOM_MEMORY_EVENTS
                             // This cast is needed to capture the type information in the PDB
                 std::ignore = reinterpret_cast<T*>(ReportCustomMemoryAlloc(alloc.Memory(), alloc.Size(), TAG_CONSTANT));
@@ -226,10 +286,39 @@ namespace DirectX
             // memory budget changes at run-time, or perhaps you're changing levels in your game.)
             DIRECTX_TOOLKIT_API void __cdecl GarbageCollect();
 
+            // Page retention policy for GarbageCollect. When idleFrames is non-zero, only pages
+            // unused for that many calls to Commit are freed, and each pool keeps enough pages to
+            // cover its peak usage over the last 120 frames. Zero (the default) frees all unused pages.
+            DIRECTX_TOOLKIT_API void __cdecl SetPageRetention(uint32_t idleFrames);
+
+            // Recent peak page count for each internal pool. Returns the number of pools, so
+            // pass nullptr to query the required size. The profile can be saved and passed
+            // to Preallocate on a later run to avoid page creation during the first frames.
+            DIRECTX_TOOLKIT_API size_t __cdecl GetPageProfile(_Out_writes_opt_(count) uint32_t* pageCounts, size_t count) const;
+            DIRECTX_TOOLKIT_API void __cdecl Preallocate(_In_reads_(count) const uint32_t* pageCounts, size_t count);
+
             // Memory statistics
             DIRECTX_TOOLKIT_API GraphicsMemoryStatistics __cdecl GetStatistics();
             DIRECTX_TOOLKIT_API void __cdecl ResetStatistics();
 
+            // Per-frame statistics for the most recent Commit calls, oldest first. Returns the
+            // number of frames written, or the number available when frames is nullptr.
+            static constexpr size_t FrameHistoryCount = 120;
+            DIRECTX_TOOLKIT_API size_t __cdecl GetFrameHistory(_Out_writes_opt_(count) GraphicsMemoryFrameStatistics* frames, size_t count) const;
+
+            // Writes the frame history as CSV with one row per frame
+            DIRECTX_TOOLKIT_API void __cdecl SaveFrameHistory(_In_z_ const wchar_t* fileName) const;
+
+            // Allocation tracing. While recording, each Allocate and Commit call is appended to a compact
+            // binary trace. ReplayTrace runs a trace through a private allocator created with this
+            // GraphicsMemory's flags and returns its statistics, so allocator options can be compared
+            // on the same workload. Throws if the trace is malformed.
+            DIRECTX_TOOLKIT_API void __cdecl StartTrace();
+            DIRECTX_TOOLKIT_API std::vector<uint8_t> __cdecl StopTrace();
+            DIRECTX_TOOLKIT_API GraphicsMemoryStatistics __cdecl ReplayTrace(
+                _In_reads_bytes_(traceSize) const void* trace, size_t traceSize,
+                _In_ ID3D12CommandQueue* commandQueue);
+
             // Properties
             DIRECTX_TOOLKIT_API ID3D12Device* __cdecl GetDevice() const noexcept;
 
@@ -242,6 +331,7 @@ namespace DirectX
             class Impl;
 
             DIRECTX_TOOLKIT_API GraphicsResource __cdecl AllocateImpl(size_t size, size_t alignment);
+            DIRECTX_TOOLKIT_API GraphicsResource __cdecl AllocateImpl(size_t size, size_t alignment, uint32_t tag);
 
         #ifdef USING_PIX_CUSTOM_MEMORY_EVENTS
                     // The declspec is required to ensure the proper information is captured in the PDB
@@ -251,6 +341,20 @@ namespace DirectX
             std::unique_ptr<Impl> pImpl;
         };
     }
+
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-dynamic-exception-spec"
+#endif
+
+    inline namespace DX12
+    {
+        DEFINE_ENUM_FLAG_OPERATORS(GRAPHICS_MEMORY_FLAGS)
+    }
+
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
 }
 
 #if defined(DIRECTX_TOOLKIT_IMPORT) && defined(_MSC_VER)
@@ -49,6 +49,31 @@
 
 namespace DirectX
 {
+    // Describes one resource for the batched Upload overload.
+    struct ResourceUploadDesc
+    {
+        ID3D12Resource*                 resource;
+        uint32_t                        subresourceIndexStart;
+        const D3D12_SUBRESOURCE_DATA*   subRes;
+        uint32_t                        numSubresources;
+    };
+
+    // Work recorded since the last Begin.
+    struct ResourceUploadStatistics
+    {
+        size_t bytesUploaded;       // Source data copied by Upload, excluding row padding
+        size_t stagingBytes;        // Upload heap memory used for staging
+        size_t copies;              // Copy commands recorded by Upload
+        size_t transitions;         // Barriers emitted by Transition
+        size_t transitionCalls;     // ResourceBarrier calls issued for Transition
+        size_t submissions;         // Command lists submitted, including staging budget splits
+        size_t mipDispatches;       // GenerateMips compute dispatches
+        size_t mipBarrierCalls;     // GenerateMips ResourceBarrier calls
+        size_t uploadCacheHits;     // UploadCached calls that returned an existing resource
+        uint64_t cpuRecordTime;     // Microseconds from Begin to End
+        uint64_t gpuLatency;        // Microseconds from submission in End until the fence signaled, zero until the future is ready
+    };
+
     // Has a command list of it's own so it can upload at any time.
     class ResourceUploadBatch
     {
@@ -78,11 +103,44 @@ namespace DirectX
             _In_ ID3D12Resource* resource,
             const SharedGraphicsResource& buffer);
 
+        // Uploads several resources through a few shared staging buffers rather than one
+        // staging buffer per resource. The memory in each subRes is copied.
+        DIRECTX_TOOLKIT_API void __cdecl Upload(
+            _In_reads_(count) const ResourceUploadDesc* uploads,
+            size_t count);
+
+        // Creates a default heap resource, uploads subRes to it and transitions it to afterState.
+        // While the upload cache is enabled, a resource created by an earlier call with the same
+        // description, source data and afterState is returned instead and nothing is uploaded.
+        // Resources the GPU can write to (unordered access, render target, depth stencil or
+        // simultaneous access) are never cached, so each call creates a new one.
+        // Returns true if a new resource was created.
+        DIRECTX_TOOLKIT_API bool __cdecl UploadCached(
+            const D3D12_RESOURCE_DESC& desc,
+            _In_reads_(numSubresources) const D3D12_SUBRESOURCE_DATA* subRes,
+            uint32_t numSubresources,
+            D3D12_RESOURCE_STATES afterState,
+            _COM_Outptr_ ID3D12Resource** pResource);
+
+        // The upload cache is off by default. It keeps a reference to each resource created by
+        // UploadCached and a copy of its source data, which is compared in full on a hash match.
+        // Begin drops the entries whose resource the application no longer references, and
+        // disabling the cache releases all of them.
+        DIRECTX_TOOLKIT_API void __cdecl SetUploadCacheEnabled(bool enable);
+        DIRECTX_TOOLKIT_API bool __cdecl IsUploadCacheEnabled() const noexcept;
+
         // Asynchronously generate mips from a resource.
         // Resource must be in the PIXEL_SHADER_RESOURCE state
         DIRECTX_TOOLKIT_API void __cdecl GenerateMips(_In_ ID3D12Resource* resource);
 
-        // Transition a resource once you're done with it
+        // Asynchronously generate mips for several resources, including texture arrays and cubemaps.
+        // Each mip level is processed for all the resources together, sharing its barrier calls.
+        // Resources must be in the PIXEL_SHADER_RESOURCE state
+        DIRECTX_TOOLKIT_API void __cdecl GenerateMips(_In_reads_(count) ID3D12Resource* const* resources, size_t count);
+
+        // Transition a resource once you're done with it. Transitions are batched into a single
+        // ResourceBarrier call, issued before the next Upload of a pending resource, GenerateMips
+        // or End. Transitions which return a resource to its pending state cancel out.
         DIRECTX_TOOLKIT_API void __cdecl Transition(
             _In_ ID3D12Resource* resource,
             D3D12_RESOURCE_STATES stateBefore,
@@ -90,8 +148,22 @@ namespace DirectX
 
         // Submits all the uploads to the driver.
         // No more uploads can happen after this call until Begin is called again.
-        // This returns a handle to an event that can be waited on.
-        DIRECTX_TOOLKIT_API std::future<void> __cdecl End(_In_ ID3D12CommandQueue* commandQueue);
+        // This returns a future which becomes ready once the GPU has finished the uploads.
+        // Unlike a std::async future, destroying it does not wait for the GPU, so call wait or
+        // get before using the resources from another queue without a fence of your own.
+        [[nodiscard]] DIRECTX_TOOLKIT_API std::future<void> __cdecl End(_In_ ID3D12CommandQueue* commandQueue);
+
+        // Limits the staging memory held by one Begin-End block. When an upload would exceed the
+        // budget, the work recorded so far is submitted to commandQueue and a new command list is
+        // started. The queue must be the one later passed to End. Zero (the default) is unlimited.
+        DIRECTX_TOOLKIT_API void __cdecl SetStagingBudget(size_t bytes, _In_opt_ ID3D12CommandQueue* commandQueue);
+
+        // Limits the staging memory of submitted batches the GPU has not finished with.
+        // End blocks until earlier batches release enough memory. Zero (the default) is unlimited.
+        DIRECTX_TOOLKIT_API void __cdecl SetInFlightBudget(size_t bytes) noexcept;
+
+        // Statistics for the current Begin-End block, or the last one after End
+        DIRECTX_TOOLKIT_API ResourceUploadStatistics __cdecl GetStatistics() const noexcept;
 
         // Validates if the given DXGI format is supported for autogen mipmaps
         DIRECTX_TOOLKIT_API bool __cdecl IsSupportedForGenerateMips(DXGI_FORMAT format) noexcept;
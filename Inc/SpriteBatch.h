@@ -92,7 +92,8 @@ namespace DirectX
                 customRootSignature(nullptr),
                 customVertexShader{},
                 customPixelShader{},
-                customCBV(false)
+                customCBV(false),
+                instanced(false)
             {
                 if (isamplerDescriptor)
                     this->samplerDescriptor = *isamplerDescriptor;
@@ -107,6 +108,7 @@ namespace DirectX
             D3D12_SHADER_BYTECODE       customVertexShader;
             D3D12_SHADER_BYTECODE       customPixelShader;
             bool                        customCBV;
+            bool                        instanced;  // Expand sprites from per-instance records in the vertex shader
 
         private:
             static const D3D12_BLEND_DESC           s_DefaultBlendDesc;
@@ -117,6 +119,35 @@ namespace DirectX
         class SpriteBatch
         {
         public:
+            // Sprites captured by BeginRetained, with their vertices kept in GPU upload memory.
+            // The vertex buffer is always allocated from a GraphicsMemory page, never from the
+            // ring buffer, so holding it for many frames does not block reuse of the ring.
+            class Retained
+            {
+            public:
+                DIRECTX_TOOLKIT_API Retained() noexcept(false);
+
+                DIRECTX_TOOLKIT_API Retained(Retained&&) noexcept;
+                DIRECTX_TOOLKIT_API Retained& operator= (Retained&&) noexcept;
+
+                Retained(Retained const&) = delete;
+                Retained& operator= (Retained const&) = delete;
+
+                DIRECTX_TOOLKIT_API virtual ~Retained();
+
+                DIRECTX_TOOLKIT_API size_t __cdecl SpriteCount() const noexcept;
+
+                // Releases the captured sprites and their vertex memory.
+                DIRECTX_TOOLKIT_API void __cdecl Reset() noexcept;
+
+            private:
+                friend class SpriteBatch;
+
+                struct Impl;
+
+                std::unique_ptr<Impl> pImpl;
+            };
+
             DIRECTX_TOOLKIT_API SpriteBatch(
                 _In_ ID3D12Device* device, ResourceUploadBatch& upload,
                 const SpriteBatchPipelineStateDescription& psoDesc,
@@ -131,6 +162,12 @@ namespace DirectX
             DIRECTX_TOOLKIT_API virtual ~SpriteBatch();
 
             // Begin/End a batch of sprite drawing operations.
+            //
+            // Unless the sort mode is SpriteSortMode_Immediate, Draw may also be called from other
+            // threads between Begin and End. Each thread records into a queue of its own, and the
+            // queues are merged at End, which must not be called until those Draw calls have returned.
+            // In SpriteSortMode_Deferred the sprites drawn by the thread which called Begin come
+            // first, followed by those of each other thread in the order the threads first drew.
             DIRECTX_TOOLKIT_API void XM_CALLCONV Begin(
                 _In_ ID3D12GraphicsCommandList* commandList,
                 SpriteSortMode sortMode = SpriteSortMode_Deferred,
@@ -161,6 +198,38 @@ namespace DirectX
 
             DIRECTX_TOOLKIT_API void __cdecl End();
 
+            // Retained batches. Between BeginRetained and End, Draw captures sprites into retained
+            // instead of drawing them. End sorts them and generates their vertices once, and
+            // DrawRetained then draws them with one draw call per texture. BeginRetainedUpdate
+            // replaces the captured sprites from firstSprite onwards, or only spriteCount of them,
+            // with the ones drawn before End, keeping their position in the captured order. Only
+            // the drawn sprites have their vertices generated; the rest keep theirs.
+            DIRECTX_TOOLKIT_API void __cdecl BeginRetained(
+                Retained& retained,
+                SpriteSortMode sortMode = SpriteSortMode_Deferred);
+
+            DIRECTX_TOOLKIT_API void __cdecl BeginRetainedUpdate(
+                Retained& retained,
+                size_t firstSprite);
+
+            DIRECTX_TOOLKIT_API void __cdecl BeginRetainedUpdate(
+                Retained& retained,
+                size_t firstSprite,
+                size_t spriteCount);
+
+            DIRECTX_TOOLKIT_API void XM_CALLCONV DrawRetained(
+                _In_ ID3D12GraphicsCommandList* commandList,
+                Retained const& retained,
+                FXMMATRIX transformMatrix = MatrixIdentity);
+                // Draw using a static sampler.
+
+            DIRECTX_TOOLKIT_API void XM_CALLCONV DrawRetained(
+                _In_ ID3D12GraphicsCommandList* commandList,
+                D3D12_GPU_DESCRIPTOR_HANDLE sampler,
+                Retained const& retained,
+                FXMMATRIX transformMatrix = MatrixIdentity);
+                // Draw with a heap-based sampler.
+
             // Draw overloads specifying position, origin and scale as XMFLOAT2.
             DIRECTX_TOOLKIT_API void XM_CALLCONV Draw(
                 D3D12_GPU_DESCRIPTOR_HANDLE textureSRV, XMUINT2 const& textureSize,
@@ -0,0 +1,52 @@
+//--------------------------------------------------------------------------------------
+// File: BenchmarkHooks.h
+//
+// Switches which select the implementations that were replaced by faster ones, so the
+// benchmarks can time both. They only exist when the library is built with
+// DIRECTX_TOOLKIT_BENCHMARK_HOOKS, which the CMake BUILD_BENCHMARKS option sets.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//
+// https://go.microsoft.com/fwlink/?LinkID=615561
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#ifdef DIRECTX_TOOLKIT_BENCHMARK_HOOKS
+
+#ifndef DIRECTX_TOOLKIT_API
+#ifdef DIRECTX_TOOLKIT_EXPORT
+#ifdef __GNUC__
+#define DIRECTX_TOOLKIT_API __attribute__ ((dllexport))
+#else
+#define DIRECTX_TOOLKIT_API __declspec(dllexport)
+#endif
+#elif defined(DIRECTX_TOOLKIT_IMPORT)
+#ifdef __GNUC__
+#define DIRECTX_TOOLKIT_API __attribute__ ((dllimport))
+#else
+#define DIRECTX_TOOLKIT_API __declspec(dllimport)
+#endif
+#else
+#define DIRECTX_TOOLKIT_API
+#endif
+#endif
+
+
+namespace DirectX
+{
+    inline namespace DX12
+    {
+        namespace BenchmarkHooks
+        {
+            // SpriteBatch generates vertices one sprite at a time instead of four at once.
+            DIRECTX_TOOLKIT_API void __cdecl SetSpriteBatchScalarVertices(bool enable) noexcept;
+
+            // SpriteBatch sorts with std::sort on the sprite pointers instead of a radix sort on extracted keys.
+            DIRECTX_TOOLKIT_API void __cdecl SetSpriteBatchComparisonSort(bool enable) noexcept;
+        }
+    }
+}
+
+#endif // DIRECTX_TOOLKIT_BENCHMARK_HOOKS
@@ -18,6 +18,46 @@
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
 
+namespace
+{
+    // Creates a default heap resource on device and records its upload and transition. While the
+    // batch's upload cache is enabled, the batch creates the resource on its own device instead,
+    // or returns an identical one created earlier. Returns false for a cached resource.
+    bool CreateAndUpload(
+        _In_ ID3D12Device* device,
+        ResourceUploadBatch& resourceUpload,
+        const D3D12_RESOURCE_DESC& desc,
+        const D3D12_SUBRESOURCE_DATA& initData,
+        D3D12_RESOURCE_STATES afterState,
+        _COM_Outptr_ ID3D12Resource** pResource)
+    {
+        if (resourceUpload.IsUploadCacheEnabled())
+        {
+            return resourceUpload.UploadCached(desc, &initData, 1, afterState, pResource);
+        }
+
+        *pResource = nullptr;
+
+        const CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+
+        ComPtr<ID3D12Resource> res;
+        ThrowIfFailed(device->CreateCommittedResource(
+            &heapProperties,
+            D3D12_HEAP_FLAG_NONE,
+            &desc,
+            c_initialCopyTargetState,
+            nullptr,
+            IID_GRAPHICS_PPV_ARGS(res.GetAddressOf())));
+
+        resourceUpload.Upload(res.Get(), 0, &initData, 1);
+
+        resourceUpload.Transition(res.Get(), D3D12_RESOURCE_STATE_COPY_DEST, afterState);
+
+        *pResource = res.Detach();
+        return true;
+    }
+}
+
 //--------------------------------------------------------------------------------------
 _Use_decl_annotations_
 HRESULT DirectX::CreateStaticBuffer(
@@ -50,26 +90,13 @@ HRESULT DirectX::CreateStaticBuffer(
 
     const auto desc = CD3DX12_RESOURCE_DESC::Buffer(sizeInbytes, resFlags);
 
-    const CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
-
-    ComPtr<ID3D12Resource> res;
-    HRESULT hr = device->CreateCommittedResource(
-        &heapProperties,
-        D3D12_HEAP_FLAG_NONE,
-        &desc,
-        c_initialCopyTargetState,
-        nullptr,
-        IID_GRAPHICS_PPV_ARGS(res.GetAddressOf()));
-    if (FAILED(hr))
-        return hr;
-
     D3D12_SUBRESOURCE_DATA initData = { ptr, 0, 0 };
 
+    ComPtr<ID3D12Resource> res;
     try
     {
-        resourceUpload.Upload(res.Get(), 0, &initData, 1);
-
-        resourceUpload.Transition(res.Get(), D3D12_RESOURCE_STATE_COPY_DEST, afterState);
+        // Creates the resource, or returns an identical one if the upload cache is enabled
+        std::ignore = CreateAndUpload(device, resourceUpload, desc, initData, afterState, res.GetAddressOf());
     }
     catch (com_exception e)
     {
@@ -222,24 +249,10 @@ HRESULT DirectX::CreateTextureFromMemory(
 
     const auto desc = CD3DX12_RESOURCE_DESC::Tex1D(format, static_cast<UINT64>(width), 1u, 1u, resFlags);
 
-    const CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
-
     ComPtr<ID3D12Resource> res;
-    HRESULT hr = device->CreateCommittedResource(
-        &heapProperties,
-        D3D12_HEAP_FLAG_NONE,
-        &desc,
-        c_initialCopyTargetState,
-        nullptr,
-        IID_GRAPHICS_PPV_ARGS(res.GetAddressOf()));
-    if (FAILED(hr))
-        return hr;
-
     try
     {
-        resourceUpload.Upload(res.Get(), 0, &initData, 1);
-
-        resourceUpload.Transition(res.Get(), D3D12_RESOURCE_STATE_COPY_DEST, afterState);
+        std::ignore = CreateAndUpload(device, resourceUpload, desc, initData, afterState, res.GetAddressOf());
     }
     catch (com_exception e)
     {
@@ -299,26 +312,12 @@ HRESULT DirectX::CreateTextureFromMemory(
     const auto desc = CD3DX12_RESOURCE_DESC::Tex2D(format, static_cast<UINT64>(width), static_cast<UINT>(height),
         1u, mipCount, 1u, 0u, resFlags);
 
-    const CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
-
     ComPtr<ID3D12Resource> res;
-    HRESULT hr = device->CreateCommittedResource(
-        &heapProperties,
-        D3D12_HEAP_FLAG_NONE,
-        &desc,
-        c_initialCopyTargetState,
-        nullptr,
-        IID_GRAPHICS_PPV_ARGS(res.GetAddressOf()));
-    if (FAILED(hr))
-        return hr;
-
     try
     {
-        resourceUpload.Upload(res.Get(), 0, &initData, 1);
-
-        resourceUpload.Transition(res.Get(), D3D12_RESOURCE_STATE_COPY_DEST, afterState);
-
-        if (generateMips)
+        // A cached texture already had its mips generated when it was created
+        if (CreateAndUpload(device, resourceUpload, desc, initData, afterState, res.GetAddressOf())
+            && generateMips)
         {
             resourceUpload.GenerateMips(res.Get());
         }
@@ -372,24 +371,10 @@ HRESULT DirectX::CreateTextureFromMemory(
         static_cast<UINT64>(width), static_cast<UINT>(height), static_cast<UINT16>(depth),
         1u, resFlags);
 
-    const CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
-
     ComPtr<ID3D12Resource> res;
-    HRESULT hr = device->CreateCommittedResource(
-        &heapProperties,
-        D3D12_HEAP_FLAG_NONE,
-        &desc,
-        c_initialCopyTargetState,
-        nullptr,
-        IID_GRAPHICS_PPV_ARGS(res.GetAddressOf()));
-    if (FAILED(hr))
-        return hr;
-
     try
     {
-        resourceUpload.Upload(res.Get(), 0, &initData, 1);
-
-        resourceUpload.Transition(res.Get(), D3D12_RESOURCE_STATE_COPY_DEST, afterState);
+        std::ignore = CreateAndUpload(device, resourceUpload, desc, initData, afterState, res.GetAddressOf());
     }
     catch (com_exception e)
     {
@@ -12,6 +12,8 @@
 #include "DirectXHelpers.h"
 #include "DescriptorHeap.h"
 
+#include <deque>
+
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
 
@@ -220,17 +222,415 @@ void DescriptorPile::AllocateRange(size_t numDescriptors, _Out_ IndexType& start
         throw std::invalid_argument("Can't allocate zero descriptors");
     }
 
-    // get the current top
-    start = m_top;
+    auto& state = *m_state;
+
+    // with nothing to reuse, bump the top without taking the lock
+    if (state.freeRangeCount.load() == 0)
+    {
+        start = AllocateFromTop(numDescriptors);
+        end = start + numDescriptors;
+        return;
+    }
 
-    // increment top with new request
-    m_top += numDescriptors;
-    end = m_top;
+    std::lock_guard<std::mutex> lock(state.mutex);
 
-    // make sure we have enough room
-    if (m_top > Count())
+    // reuse the smallest freed range that is large enough
+    auto fit = state.freeBySize.lower_bound(std::make_pair(numDescriptors, IndexType(0)));
+    if (fit != state.freeBySize.end())
     {
-        DebugTrace("DescriptorPile has %zu of %zu descriptors; failed request for %zu more\n", start, Count(), numDescriptors);
-        throw std::runtime_error("Can't allocate more descriptors");
+        const IndexType rangeStart = fit->second;
+        const size_t rangeSize = fit->first;
+
+        EraseFreeRange(state.freeRanges.find(rangeStart));
+        if (rangeSize > numDescriptors)
+        {
+            InsertFreeRange(rangeStart + numDescriptors, rangeSize - numDescriptors);
+        }
+
+        start = rangeStart;
+        end = rangeStart + numDescriptors;
+        return;
     }
+
+    start = AllocateFromTop(numDescriptors);
+    end = start + numDescriptors;
+}
+
+
+void DescriptorPile::Free(IndexType start, size_t numDescriptors)
+{
+    if (numDescriptors == 0)
+        return;
+
+    auto& state = *m_state;
+
+    std::lock_guard<std::mutex> lock(state.mutex);
+
+    const IndexType top = state.top.load();
+    if (start >= top || numDescriptors > top - start)
+    {
+        throw std::out_of_range("Freed descriptor range was not allocated");
+    }
+
+    // merge with the neighboring freed ranges
+    auto next = state.freeRanges.lower_bound(start);
+    if (next != state.freeRanges.end() && next->first < start + numDescriptors)
+    {
+        throw std::invalid_argument("Descriptor range is already free");
+    }
+
+    if (next != state.freeRanges.begin())
+    {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second > start)
+        {
+            throw std::invalid_argument("Descriptor range is already free");
+        }
+
+        if (prev->first + prev->second == start)
+        {
+            start = prev->first;
+            numDescriptors += prev->second;
+            EraseFreeRange(prev);
+        }
+    }
+
+    if (next != state.freeRanges.end() && next->first == start + numDescriptors)
+    {
+        numDescriptors += next->second;
+        EraseFreeRange(next);
+    }
+
+    // a range ending at the top lowers it instead of being kept, unless another
+    // thread has bumped the top in the meantime
+    IndexType expected = start + numDescriptors;
+    if (state.top.compare_exchange_strong(expected, start))
+        return;
+
+    InsertFreeRange(start, numDescriptors);
+}
+
+
+DescriptorPileStatistics DescriptorPile::GetStatistics() const
+{
+    auto& state = *m_state;
+
+    std::lock_guard<std::mutex> lock(state.mutex);
+
+    DescriptorPileStatistics stats = {};
+    stats.top = state.top.load();
+    stats.freeRanges = state.freeRanges.size();
+    for (const auto& it : state.freeRanges)
+    {
+        stats.freeDescriptors += it.second;
+    }
+    if (!state.freeBySize.empty())
+    {
+        stats.largestFreeRange = state.freeBySize.rbegin()->first;
+    }
+    stats.allocated = stats.top - stats.freeDescriptors;
+
+    return stats;
+}
+
+
+DescriptorPile::IndexType DescriptorPile::AllocateFromTop(size_t numDescriptors)
+{
+    auto& top = m_state->top;
+
+    IndexType start = top.load();
+    do
+    {
+        // make sure we have enough room
+        if (numDescriptors > Count() - start)
+        {
+            DebugTrace("DescriptorPile has %zu of %zu descriptors; failed request for %zu more\n", start, Count(), numDescriptors);
+            throw std::runtime_error("Can't allocate more descriptors");
+        }
+    } while (!top.compare_exchange_weak(start, start + numDescriptors));
+
+    return start;
+}
+
+
+void DescriptorPile::InsertFreeRange(IndexType start, size_t numDescriptors)
+{
+    auto& state = *m_state;
+    state.freeRanges.emplace(start, numDescriptors);
+    state.freeBySize.emplace(numDescriptors, start);
+    state.freeRangeCount.store(state.freeRanges.size());
+}
+
+
+void DescriptorPile::EraseFreeRange(std::map<IndexType, size_t>::iterator it)
+{
+    auto& state = *m_state;
+    state.freeBySize.erase(std::make_pair(it->second, it->first));
+    state.freeRanges.erase(it);
+    state.freeRangeCount.store(state.freeRanges.size());
+}
+
+
+//======================================================================================
+// DescriptorRing
+//======================================================================================
+
+class DescriptorRing::Impl
+{
+public:
+    Impl(
+        _In_ ID3D12Device* device,
+        D3D12_DESCRIPTOR_HEAP_TYPE type,
+        size_t count)
+        : mHeap(device, type, D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE, count)
+        , mDevice(device)
+        , mHead(0)
+        , mInUse(0)
+        , mFrameUsed(0)
+        , mFenceCount(0)
+        , mCopyCalls(0)
+        , mStalls(0)
+        , mDestEnd(0)
+    {
+        if (!count)
+            throw std::invalid_argument("DescriptorRing needs at least one descriptor");
+
+        ThrowIfFailed(device->CreateFence(
+            0,
+            D3D12_FENCE_FLAG_NONE,
+            IID_GRAPHICS_PPV_ARGS(mFence.ReleaseAndGetAddressOf())));
+
+        SetDebugObjectName(mFence.Get(), L"DescriptorRing");
+
+        mEvent.reset(CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE));
+        if (!mEvent)
+            throw std::system_error(std::error_code(static_cast<int>(GetLastError()), std::system_category()), "CreateEventEx");
+    }
+
+    D3D12_GPU_DESCRIPTOR_HANDLE Stage(
+        _In_reads_(descriptorCount) const D3D12_CPU_DESCRIPTOR_HANDLE* pDescriptors,
+        uint32_t descriptorCount)
+    {
+        if (!pDescriptors || !descriptorCount)
+            throw std::invalid_argument("Descriptors are null");
+
+        const size_t capacity = mHeap.Count();
+        if (descriptorCount > capacity)
+            throw std::invalid_argument("Too many descriptors for DescriptorRing");
+
+        // A range can't wrap around, so the rest of the heap is skipped if it doesn't fit
+        const size_t padding = (mHead + descriptorCount > capacity) ? capacity - mHead : 0;
+
+        // Reclaim committed frames, oldest first, until there is room
+        while (mInUse + padding + descriptorCount > capacity)
+        {
+            if (mFrames.empty())
+            {
+                DebugTrace("ERROR: DescriptorRing of %zu descriptors is full for a single frame\n", capacity);
+                throw std::runtime_error("DescriptorRing is full");
+            }
+
+            const auto& frame = mFrames.front();
+            if (mFence->GetCompletedValue() < frame.fenceValue)
+            {
+                ++mStalls;
+                WaitForFence(frame.fenceValue);
+            }
+
+            mInUse -= frame.descriptorCount;
+            mFrames.pop_front();
+        }
+
+        const size_t start = (padding > 0) ? 0 : mHead;
+        mHead = (start + descriptorCount) % capacity;
+        mInUse += padding + descriptorCount;
+        mFrameUsed += padding + descriptorCount;
+
+        // Adjacent destinations are merged into one range
+        if (!mDestSizes.empty() && mDestEnd == start)
+        {
+            mDestSizes.back() += descriptorCount;
+        }
+        else
+        {
+            mDestStarts.push_back(mHeap.GetCpuHandle(start));
+            mDestSizes.push_back(descriptorCount);
+        }
+        mDestEnd = start + descriptorCount;
+
+        mSources.insert(mSources.end(), pDescriptors, pDescriptors + descriptorCount);
+
+        return mHeap.GetGpuHandle(start);
+    }
+
+    void Flush()
+    {
+        if (mSources.empty())
+            return;
+
+        // Each source is a range of one descriptor
+        mDevice->CopyDescriptors(
+            static_cast<UINT>(mDestStarts.size()),
+            mDestStarts.data(),
+            mDestSizes.data(),
+            static_cast<UINT>(mSources.size()),
+            mSources.data(),
+            nullptr,
+            mHeap.Type());
+
+        ++mCopyCalls;
+
+        mSources.clear();
+        mDestStarts.clear();
+        mDestSizes.clear();
+    }
+
+    void Commit(_In_ ID3D12CommandQueue* commandQueue)
+    {
+        if (!commandQueue)
+            throw std::invalid_argument("Direct3D queue is null");
+
+        Flush();
+
+        if (mFrameUsed > 0)
+        {
+            ++mFenceCount;
+            ThrowIfFailed(commandQueue->Signal(mFence.Get(), mFenceCount));
+
+            mFrames.push_back(Frame{ mFenceCount, mFrameUsed });
+            mFrameUsed = 0;
+        }
+
+        // Reclaim whatever the GPU has already finished with
+        const uint64_t completed = mFence->GetCompletedValue();
+        while (!mFrames.empty() && mFrames.front().fenceValue <= completed)
+        {
+            mInUse -= mFrames.front().descriptorCount;
+            mFrames.pop_front();
+        }
+    }
+
+    ID3D12DescriptorHeap* Heap() const noexcept { return mHeap.Heap(); }
+    size_t InUseCount() const noexcept { return mInUse; }
+    size_t CopyCallCount() const noexcept { return mCopyCalls; }
+    size_t StallCount() const noexcept { return mStalls; }
+
+private:
+    // Descriptors consumed by a committed frame, including any skipped at the end of the heap
+    struct Frame
+    {
+        uint64_t    fenceValue;
+        size_t      descriptorCount;
+    };
+
+    DescriptorHeap                              mHeap;
+    ComPtr<ID3D12Device>                        mDevice;
+    ComPtr<ID3D12Fence>                         mFence;
+    ScopedHandle                                mEvent;
+    std::deque<Frame>                           mFrames;
+    size_t                                      mHead;
+    size_t                                      mInUse;
+    size_t                                      mFrameUsed;
+    uint64_t                                    mFenceCount;
+    size_t                                      mCopyCalls;
+    size_t                                      mStalls;
+
+    // Copies waiting for Flush
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE>    mSources;
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE>    mDestStarts;
+    std::vector<UINT>                           mDestSizes;
+    size_t                                      mDestEnd;
+
+    void WaitForFence(uint64_t fenceValue)
+    {
+        ThrowIfFailed(mFence->SetEventOnCompletion(fenceValue, mEvent.get()));
+
+        const DWORD wr = WaitForSingleObjectEx(mEvent.get(), INFINITE, FALSE);
+        if (wr != WAIT_OBJECT_0)
+        {
+            if (wr == WAIT_FAILED)
+            {
+                throw std::system_error(std::error_code(static_cast<int>(GetLastError()), std::system_category()), "WaitForSingleObjectEx");
+            }
+            else
+            {
+                throw std::runtime_error("WaitForSingleObjectEx");
+            }
+        }
+    }
+};
+
+
+_Use_decl_annotations_
+DescriptorRing::DescriptorRing(
+    ID3D12Device* device,
+    D3D12_DESCRIPTOR_HEAP_TYPE type,
+    size_t count)
+{
+    if (!device)
+        throw std::invalid_argument("Direct3D device is null");
+
+    switch (type)
+    {
+    case D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV:
+    case D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER:
+        break;
+
+    default:
+        DebugTrace("DescriptorRing only supports shader visible heap types\n");
+        throw std::invalid_argument("type parameter is invalid");
+    }
+
+    pImpl = std::make_unique<Impl>(device, type, count);
+}
+
+
+DescriptorRing::DescriptorRing(DescriptorRing&&) noexcept = default;
+DescriptorRing& DescriptorRing::operator= (DescriptorRing&&) noexcept = default;
+DescriptorRing::~DescriptorRing() = default;
+
+
+_Use_decl_annotations_
+D3D12_GPU_DESCRIPTOR_HANDLE DescriptorRing::Stage(
+    const D3D12_CPU_DESCRIPTOR_HANDLE* pDescriptors,
+    uint32_t descriptorCount)
+{
+    return pImpl->Stage(pDescriptors, descriptorCount);
+}
+
+
+void DescriptorRing::Flush()
+{
+    pImpl->Flush();
+}
+
+
+_Use_decl_annotations_
+void DescriptorRing::Commit(ID3D12CommandQueue* commandQueue)
+{
+    pImpl->Commit(commandQueue);
+}
+
+
+ID3D12DescriptorHeap* DescriptorRing::Heap() const noexcept
+{
+    return pImpl->Heap();
+}
+
+
+size_t DescriptorRing::InUseCount() const noexcept
+{
+    return pImpl->InUseCount();
+}
+
+
+size_t DescriptorRing::CopyCallCount() const noexcept
+{
+    return pImpl->CopyCallCount();
+}
+
+
+size_t DescriptorRing::StallCount() const noexcept
+{
+    return pImpl->StallCount();
 }
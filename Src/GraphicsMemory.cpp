@@ -9,6 +9,7 @@
 
 #include "pch.h"
 #include "GraphicsMemory.h"
+#include "DirectXHelpers.h"
 #include "PlatformHelpers.h"
 #include "LinearAllocator.h"
 
@@ -28,11 +29,40 @@ namespace
     constexpr size_t AllocatorIndexShift = 12; // start block sizes at 4KB
     constexpr size_t AllocatorPoolCount = 21; // allocation sizes up to 2GB supported
     constexpr size_t PoolIndexScale = 1; // multiply the allocation size this amount to push large values into the next bucket
+    constexpr size_t ThreadCachePoolCount = 4; // pools up to 16KB are suballocated from per-thread pages
+    constexpr size_t MinSizeClass = 256; // smallest fixed-size slot for small allocations
+    constexpr size_t SizeClassCount = GraphicsMemoryStatistics::SizeClassCount; // 256B, 512B, 1KB, and 2KB slots
+    constexpr size_t MaxSizeClass = MinSizeClass << (SizeClassCount - 1);
+    constexpr size_t DefaultRingBufferSize = 32 * 1024 * 1024;
+    constexpr size_t RingChunkSize = MinPageSize;
+    constexpr size_t RingAllocLimit = GraphicsMemory::RingBufferAllocationLimit; // larger requests always use the page pools
+    constexpr size_t RingCacheIndex = ThreadCachePoolCount + SizeClassCount;
+    constexpr size_t PlacedHeapSize = 4 * 1024 * 1024;
+    constexpr size_t MaxPlacedPageSize = PlacedHeapSize / 4; // larger pages are always committed resources
+    constexpr size_t TagCount = GraphicsMemoryStatistics::TagCount;
+    constexpr size_t PoolCount = GraphicsMemoryStatistics::PoolCount;
+    constexpr size_t RingPoolIndex = AllocatorPoolCount + SizeClassCount; // statistics slot for ring buffer requests
+    constexpr size_t FrameHistoryCount = GraphicsMemory::FrameHistoryCount;
 
     static_assert((1 << AllocatorIndexShift) == MinAllocSize, "1 << AllocatorIndexShift must == MinPageSize (in KiB)");
     static_assert((MinPageSize & (MinPageSize - 1)) == 0, "MinPageSize size must be a power of 2");
     static_assert((MinAllocSize & (MinAllocSize - 1)) == 0, "MinAllocSize size must be a power of 2");
     static_assert(MinAllocSize >= (4 * 1024), "MinAllocSize size must be greater than 4K");
+    static_assert(ThreadCachePoolCount <= AllocatorPoolCount, "ThreadCachePoolCount must not exceed AllocatorPoolCount");
+    static_assert(RingAllocLimit <= RingChunkSize / 4, "RingAllocLimit must leave room for several requests per ring chunk");
+    static_assert((MinSizeClass & (MinSizeClass - 1)) == 0, "MinSizeClass size must be a power of 2");
+    static_assert(MaxSizeClass < MinAllocSize, "Size classes must be smaller than MinAllocSize");
+    constexpr uint64_t MaxTraceAllocSize = uint64_t(1) << (AllocatorIndexShift + AllocatorPoolCount - 2); // size plus alignment of the largest pool
+    constexpr uint32_t TraceMagic = 0x52544D47; // "GMTR"
+    constexpr uint8_t TraceVersion = 1;
+
+    enum TraceOp : uint8_t
+    {
+        TRACE_ALLOC = 0,    // varint size, varint alignment, varint tag
+        TRACE_COMMIT,
+    };
+
+    static_assert(PoolCount == AllocatorPoolCount + SizeClassCount + 1, "GraphicsMemoryStatistics::PoolCount must cover every pool and the ring buffer");
 
     constexpr size_t NextPow2(size_t x) noexcept
     {
@@ -87,24 +117,152 @@ namespace
         return std::max<size_t>(MinPageSize, size_t(1) << (x + AllocatorIndexShift));
     }
 
+    inline size_t GetSizeClassIndex(size_t slotSize) noexcept
+    {
+        size_t index = 0;
+        for (size_t classSize = MinSizeClass; classSize < slotSize; classSize <<= 1)
+        {
+            ++index;
+        }
+        return index;
+    }
+
+    inline void AddUsage(GraphicsMemoryUsageStatistics& usage, size_t size) noexcept
+    {
+        usage.allocatedMemory += size;
+        ++usage.allocationCount;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // ThreadPageCache : pages reserved by one thread for one allocator, and the thread's request
+    // counts since the last Commit. Only the owning thread allocates through it, so the mutex is
+    // uncontended except while Commit retires the pages and collects the counts.
+    //--------------------------------------------------------------------------------------
+    struct ThreadPageCache
+    {
+        std::mutex              mutex;
+        LinearAllocatorPage*    pages[ThreadCachePoolCount + SizeClassCount + 1];
+        std::array<GraphicsMemoryUsageStatistics, TagCount> tags;
+        std::array<GraphicsMemoryUsageStatistics, PoolCount> pools;
+        bool                    detached;   // The thread or the allocator has gone away
+
+        ThreadPageCache() noexcept : pages{}, tags{}, pools{}, detached(false) {}
+
+        ThreadPageCache(ThreadPageCache&&) = delete;
+        ThreadPageCache& operator= (ThreadPageCache&&) = delete;
+
+        ThreadPageCache(ThreadPageCache const&) = delete;
+        ThreadPageCache& operator= (ThreadPageCache const&) = delete;
+
+        // Requires mutex to be held
+        void ReleasePages() noexcept
+        {
+            for (auto& page : pages)
+            {
+                if (page)
+                {
+                    page->Release();
+                    page = nullptr;
+                }
+            }
+        }
+    };
+
+    // The caches of the calling thread, keyed by allocator id
+    struct ThreadPageCacheList
+    {
+        std::vector<std::pair<uint64_t, std::shared_ptr<ThreadPageCache>>> caches;
+
+        ThreadPageCacheList() = default;
+
+        ThreadPageCacheList(ThreadPageCacheList&&) = delete;
+        ThreadPageCacheList& operator= (ThreadPageCacheList&&) = delete;
+
+        ThreadPageCacheList(ThreadPageCacheList const&) = delete;
+        ThreadPageCacheList& operator= (ThreadPageCacheList const&) = delete;
+
+        // An exiting thread gives up its pages now, and its allocators drop the caches at the next Commit
+        ~ThreadPageCacheList()
+        {
+            for (auto& it : caches)
+            {
+                const ScopedLock lock(it.second->mutex);
+
+                it.second->ReleasePages();
+                it.second->detached = true;
+            }
+        }
+    };
+
+    thread_local ThreadPageCacheList s_threadPageCaches;
+
+    //--------------------------------------------------------------------------------------
+    // Allocation trace encoding
+    //--------------------------------------------------------------------------------------
+    void AppendVarint(std::vector<uint8_t>& trace, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            trace.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        trace.push_back(static_cast<uint8_t>(value));
+    }
+
+    bool ReadVarint(const uint8_t*& ptr, const uint8_t* end, uint64_t& value) noexcept
+    {
+        value = 0;
+        for (unsigned shift = 0; ptr < end && shift < 64; shift += 7)
+        {
+            const uint8_t byte = *ptr++;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    std::atomic<uint64_t> s_nextAllocatorId(1);
+
     //--------------------------------------------------------------------------------------
     // DeviceAllocator : honors memory requests associated with a particular device
     //--------------------------------------------------------------------------------------
     class DeviceAllocator
     {
     public:
-        DeviceAllocator(_In_ ID3D12Device* device) noexcept(false)
+        DeviceAllocator(_In_ ID3D12Device* device, GRAPHICS_MEMORY_FLAGS flags, size_t ringBufferSize) noexcept(false)
             : mDevice(device)
+            , mId(s_nextAllocatorId.fetch_add(1))
+            , mRingFallbacks(0)
+            , mIdleFrames(0)
+            , mTotalTags{}
+            , mTotalPools{}
+            , mFrameHistory{}
+            , mFrameCount(0)
+            , mTracing(false)
         {
             if (!device)
                 throw std::invalid_argument("Invalid device parameter");
 
+            if (flags & GRAPHICS_MEMORY_RING_BUFFER)
+            {
+                mRing = std::make_unique<RingAllocator>(
+                    mDevice.Get(),
+                    RingChunkSize,
+                    ringBufferSize ? ringBufferSize : DefaultRingBufferSize);
+            }
+
+            const bool placedPages = (flags & GRAPHICS_MEMORY_PLACED_PAGES) != 0;
+
+            // Size class pools follow the power of 2 pools and always use the minimum page size
             for (size_t i = 0; i < mPools.size(); ++i)
             {
-                size_t pageSize = GetPageSizeFromPoolIndex(i);
+                size_t pageSize = (i < AllocatorPoolCount) ? GetPageSizeFromPoolIndex(i) : MinPageSize;
                 mPools[i] = std::make_unique<LinearAllocator>(
                     mDevice.Get(),
-                    pageSize);
+                    pageSize,
+                    0,
+                    (placedPages && pageSize <= MaxPlacedPageSize) ? PlacedHeapSize : 0);
             }
         }
 
@@ -117,22 +275,86 @@ namespace
         // Explicitly destroy LinearAllocators inside a critical section
         ~DeviceAllocator()
         {
+            // Take back the pages still cached by other threads
+            {
+                const ScopedLock lock(mCacheMutex);
+
+                for (auto& cache : mThreadCaches)
+                {
+                    const ScopedLock cacheLock(cache->mutex);
+
+                    cache->ReleasePages();
+                    cache->detached = true;
+                }
+
+                mThreadCaches.clear();
+            }
+
             const ScopedLock lock(mMutex);
 
+            mRing.reset();
+
             for (auto& allocator : mPools)
             {
                 allocator.reset();
             }
         }
 
-        GraphicsResource Alloc(_In_ size_t size, _In_ size_t alignment)
+        GraphicsResource Alloc(_In_ size_t size, _In_ size_t alignment, uint32_t tag)
         {
-            ScopedLock lock(mMutex);
+            if (mTracing.load(std::memory_order_relaxed))
+            {
+                ScopedLock lock(mMutex);
+
+                if (mTracing.load(std::memory_order_relaxed))
+                {
+                    mTrace.push_back(TRACE_ALLOC);
+                    AppendVarint(mTrace, size);
+                    AppendVarint(mTrace, alignment);
+                    AppendVarint(mTrace, tag);
+                }
+            }
+
+            // Request counts are kept per thread and collected by Commit
+            auto& cache = GetThreadPageCache();
+            const ScopedLock cacheLock(cache.mutex);
+
+            AddUsage(cache.tags[(tag < TagCount) ? tag : GraphicsMemory::TAG_GENERIC], size);
+
+            if (mRing && (size + alignment) <= RingAllocLimit)
+            {
+                const size_t poolIndex = GetPoolIndexFromSize(NextPow2((alignment + size) * PoolIndexScale));
+                assert(poolIndex < ThreadCachePoolCount);
+
+                AddUsage(cache.pools[RingPoolIndex], size);
+                return AllocFromThreadCache(cache, poolIndex, RingCacheIndex, size, alignment);
+            }
+
+            // Small requests are packed into fixed-size slots, which also satisfies the alignment
+            const size_t slotSize = std::max(size, alignment);
+            if (slotSize <= MaxSizeClass)
+            {
+                const size_t classSize = std::max(MinSizeClass, NextPow2(slotSize));
+                const size_t classIndex = GetSizeClassIndex(classSize);
+                assert(classIndex < SizeClassCount);
+
+                AddUsage(cache.pools[AllocatorPoolCount + classIndex], size);
+                return AllocFromThreadCache(cache, AllocatorPoolCount + classIndex, ThreadCachePoolCount + classIndex, size, classSize);
+            }
 
             // Which memory pool does it live in?
             const size_t poolSize = NextPow2((alignment + size) * PoolIndexScale);
             const size_t poolIndex = GetPoolIndexFromSize(poolSize);
-            assert(poolIndex < mPools.size());
+            assert(poolIndex < AllocatorPoolCount);
+
+            AddUsage(cache.pools[poolIndex], size);
+
+            if (poolIndex < ThreadCachePoolCount)
+            {
+                return AllocFromThreadCache(cache, poolIndex, poolIndex, size, alignment);
+            }
+
+            ScopedLock lock(mMutex);
 
             // If the allocator isn't initialized yet, do so now
             auto& allocator = mPools[poolIndex];
@@ -146,23 +368,24 @@ namespace
                 throw std::bad_alloc();
             }
 
-            size_t offset = page->Suballocate(size, alignment);
-
-            // Return the information to the user
-            return GraphicsResource(
-                page,
-                page->GpuAddress() + offset,
-                page->UploadResource(),
-                static_cast<BYTE*>(page->BaseMemory()) + offset,
-                offset,
-                size);
+            return MakeResource(page, size, alignment);
         }
 
         // Submit page fences to the command queue
         void KickFences(_In_ ID3D12CommandQueue* commandQueue)
         {
+            // Pages reserved by every thread are fenced with this frame, even if the thread is idle
+            std::array<GraphicsMemoryUsageStatistics, TagCount> frameTags = {};
+            std::array<GraphicsMemoryUsageStatistics, PoolCount> framePools = {};
+            CollectThreadPageCaches(frameTags, framePools, true);
+
             ScopedLock lock(mMutex);
 
+            if (mRing)
+            {
+                mRing->FenceCommittedChunks(commandQueue);
+            }
+
             for (auto& i : mPools)
             {
                 if (i)
@@ -171,6 +394,31 @@ namespace
                     i->FenceCommittedPages(commandQueue);
                 }
             }
+
+            if (mTracing.load(std::memory_order_relaxed))
+            {
+                mTrace.push_back(TRACE_COMMIT);
+            }
+
+            // Close out this frame's request counts
+            auto& frame = mFrameHistory[mFrameCount % FrameHistoryCount];
+            frame = {};
+            frame.frameIndex = mFrameCount++;
+            GetMemoryUsage(frame.committedMemory, frame.totalMemory, frame.totalPages);
+
+            for (size_t j = 0; j < TagCount; ++j)
+            {
+                frame.tags[j] = frameTags[j];
+                mTotalTags[j].allocatedMemory += frame.tags[j].allocatedMemory;
+                mTotalTags[j].allocationCount += frame.tags[j].allocationCount;
+            }
+
+            for (size_t j = 0; j < PoolCount; ++j)
+            {
+                frame.pools[j] = framePools[j];
+                mTotalPools[j].allocatedMemory += frame.pools[j].allocatedMemory;
+                mTotalPools[j].allocationCount += frame.pools[j].allocationCount;
+            }
         }
 
         void GarbageCollect()
@@ -181,43 +429,388 @@ namespace
             {
                 if (i)
                 {
-                    i->Shrink();
+                    i->Shrink(mIdleFrames);
                 }
             }
         }
 
-        void GetStatistics(GraphicsMemoryStatistics& stats) const
+        void SetPageRetention(uint32_t idleFrames) noexcept
         {
-            size_t totalPageCount = 0;
-            size_t committedMemoryUsage = 0;
-            size_t totalMemoryUsage = 0;
+            ScopedLock lock(mMutex);
+
+            mIdleFrames = idleFrames;
+        }
 
+        size_t GetPageProfile(_Out_writes_opt_(count) uint32_t* pageCounts, size_t count) const noexcept
+        {
             ScopedLock lock(mMutex);
 
-            for (auto& i : mPools)
+            if (pageCounts)
             {
-                if (i)
+                for (size_t i = 0; i < count && i < mPools.size(); ++i)
+                {
+                    pageCounts[i] = (mPools[i]) ? static_cast<uint32_t>(mPools[i]->PeakPageCount()) : 0u;
+                }
+            }
+
+            return mPools.size();
+        }
+
+        void Preallocate(_In_reads_(count) const uint32_t* pageCounts, size_t count)
+        {
+            if (!pageCounts && count > 0)
+                throw std::invalid_argument("Invalid page count parameter");
+
+            ScopedLock lock(mMutex);
+
+            for (size_t i = 0; i < count && i < mPools.size(); ++i)
+            {
+                if (mPools[i] && pageCounts[i] > 0)
                 {
-                    totalPageCount += i->TotalPageCount();
-                    committedMemoryUsage += i->CommittedMemoryUsage();
-                    totalMemoryUsage += i->TotalMemoryUsage();
+                    mPools[i]->Preallocate(pageCounts[i]);
                 }
             }
+        }
+
+        void GetStatistics(GraphicsMemoryStatistics& stats)
+        {
+            // Totals include the requests made since the last Commit
+            std::array<GraphicsMemoryUsageStatistics, TagCount> currentTags = {};
+            std::array<GraphicsMemoryUsageStatistics, PoolCount> currentPools = {};
+            CollectThreadPageCaches(currentTags, currentPools, false);
+
+            ScopedLock lock(mMutex);
 
             stats = {};
-            stats.committedMemory = committedMemoryUsage;
-            stats.totalMemory = totalMemoryUsage;
-            stats.totalPages = totalPageCount;
+
+            GetMemoryUsage(stats.committedMemory, stats.totalMemory, stats.totalPages);
+
+            if (mRing)
+            {
+                stats.ringBufferStalls = mRing->StallCount();
+                stats.ringBufferFallbacks = mRingFallbacks;
+            }
+
+            for (size_t j = 0; j < TagCount; ++j)
+            {
+                stats.tags[j].allocatedMemory = mTotalTags[j].allocatedMemory + currentTags[j].allocatedMemory;
+                stats.tags[j].allocationCount = mTotalTags[j].allocationCount + currentTags[j].allocationCount;
+            }
+
+            for (size_t j = 0; j < PoolCount; ++j)
+            {
+                stats.pools[j].allocatedMemory = mTotalPools[j].allocatedMemory + currentPools[j].allocatedMemory;
+                stats.pools[j].allocationCount = mTotalPools[j].allocationCount + currentPools[j].allocationCount;
+            }
+
+            for (size_t j = 0; j < SizeClassCount; ++j)
+            {
+                auto& allocator = mPools[AllocatorPoolCount + j];
+                assert(allocator != nullptr);
+
+                const size_t usedMemory = allocator->RequestedMemoryUsage();
+                const size_t inUseMemory = allocator->InUseMemoryUsage();
+
+                auto& sizeClass = stats.sizeClasses[j];
+                sizeClass.allocationSize = MinSizeClass << j;
+                sizeClass.usedMemory = usedMemory;
+                sizeClass.wastedMemory = (inUseMemory > usedMemory) ? (inUseMemory - usedMemory) : 0;
+                sizeClass.totalPages = allocator->TotalPageCount();
+            }
+        }
+
+        void ResetStatistics() noexcept
+        {
+            ScopedLock lock(mMutex);
+
+            mTotalTags = {};
+            mTotalPools = {};
+        }
+
+        size_t GetFrameHistory(_Out_writes_opt_(count) GraphicsMemoryFrameStatistics* frames, size_t count) const noexcept
+        {
+            ScopedLock lock(mMutex);
+
+            const auto available = static_cast<size_t>(std::min<uint64_t>(mFrameCount, FrameHistoryCount));
+            if (!frames)
+                return available;
+
+            // Return the most recent frames, oldest first
+            const size_t frameCount = std::min(count, available);
+            const uint64_t start = mFrameCount - frameCount;
+            for (size_t j = 0; j < frameCount; ++j)
+            {
+                frames[j] = mFrameHistory[(start + j) % FrameHistoryCount];
+            }
+
+            return frameCount;
+        }
+
+        void StartTrace()
+        {
+            ScopedLock lock(mMutex);
+
+            mTrace.clear();
+            for (size_t j = 0; j < sizeof(TraceMagic); ++j)
+            {
+                mTrace.push_back(static_cast<uint8_t>(TraceMagic >> (j * 8)));
+            }
+            mTrace.push_back(TraceVersion);
+
+            mTracing.store(true, std::memory_order_relaxed);
+        }
+
+        std::vector<uint8_t> StopTrace()
+        {
+            ScopedLock lock(mMutex);
+
+            mTracing.store(false, std::memory_order_relaxed);
+
+            return std::move(mTrace);
         }
 
         ID3D12Device* GetDevice() const noexcept { return mDevice.Get(); }
 
     private:
         ComPtr<ID3D12Device> mDevice;
-        std::array<std::unique_ptr<LinearAllocator>, AllocatorPoolCount> mPools;
+        std::array<std::unique_ptr<LinearAllocator>, AllocatorPoolCount + SizeClassCount> mPools;
+        std::unique_ptr<RingAllocator> mRing;
         mutable std::mutex mMutex;
+        const uint64_t mId;
+        std::mutex mCacheMutex; // Never taken after mMutex or a ThreadPageCache mutex
+        std::vector<std::shared_ptr<ThreadPageCache>> mThreadCaches;
+        size_t mRingFallbacks;
+        uint32_t mIdleFrames;
+        std::array<GraphicsMemoryUsageStatistics, TagCount> mTotalTags;
+        std::array<GraphicsMemoryUsageStatistics, PoolCount> mTotalPools;
+        std::array<GraphicsMemoryFrameStatistics, FrameHistoryCount> mFrameHistory;
+        uint64_t mFrameCount;
+        std::atomic<bool> mTracing;
+        std::vector<uint8_t> mTrace;
+
+        // Requires mMutex to be held
+        void GetMemoryUsage(size_t& committedMemory, size_t& totalMemory, size_t& totalPages) const noexcept
+        {
+            committedMemory = 0;
+            totalMemory = 0;
+            totalPages = 0;
+
+            for (auto& i : mPools)
+            {
+                if (i)
+                {
+                    totalPages += i->TotalPageCount();
+                    committedMemory += i->CommittedMemoryUsage();
+                    totalMemory += i->TotalMemoryUsage();
+                }
+            }
+
+            if (mRing)
+            {
+                totalPages += mRing->ChunkCount();
+                committedMemory += mRing->CommittedMemoryUsage();
+                totalMemory += mRing->TotalMemoryUsage();
+            }
+        }
+
+        static GraphicsResource MakeResource(_In_ LinearAllocatorPage* page, size_t size, size_t alignment)
+        {
+            const size_t offset = page->Suballocate(size, alignment);
+
+            // Return the information to the user
+            return GraphicsResource(
+                page,
+                page->GpuAddress() + offset,
+                page->UploadResource(),
+                static_cast<BYTE*>(page->BaseMemory()) + offset,
+                page->ResourceOffset() + offset,
+                size);
+        }
+
+        // Returns the calling thread's cache for this allocator, registering a new one on first use
+        ThreadPageCache& GetThreadPageCache()
+        {
+            auto& caches = s_threadPageCaches.caches;
+            for (auto& it : caches)
+            {
+                if (it.first == mId)
+                    return *it.second;
+            }
+
+            // Forget the caches of allocators which have been destroyed
+            caches.erase(std::remove_if(caches.begin(), caches.end(),
+                [](const std::pair<uint64_t, std::shared_ptr<ThreadPageCache>>& it)
+                {
+                    const ScopedLock lock(it.second->mutex);
+                    return it.second->detached;
+                }), caches.end());
+
+            auto cache = std::make_shared<ThreadPageCache>();
+            caches.emplace_back(mId, cache);
+
+            {
+                const ScopedLock lock(mCacheMutex);
+                mThreadCaches.push_back(cache);
+            }
+
+            return *cache;
+        }
+
+        // Adds up the request counts of every thread. When retiring, the counts are reset, the cached
+        // pages are released so the next fence covers them, and the caches of exited threads are dropped.
+        void CollectThreadPageCaches(
+            std::array<GraphicsMemoryUsageStatistics, TagCount>& tags,
+            std::array<GraphicsMemoryUsageStatistics, PoolCount>& pools,
+            bool retire)
+        {
+            const ScopedLock lock(mCacheMutex);
+
+            mThreadCaches.erase(std::remove_if(mThreadCaches.begin(), mThreadCaches.end(),
+                [&](const std::shared_ptr<ThreadPageCache>& cache)
+                {
+                    const ScopedLock cacheLock(cache->mutex);
+
+                    for (size_t j = 0; j < TagCount; ++j)
+                    {
+                        tags[j].allocatedMemory += cache->tags[j].allocatedMemory;
+                        tags[j].allocationCount += cache->tags[j].allocationCount;
+                    }
+
+                    for (size_t j = 0; j < PoolCount; ++j)
+                    {
+                        pools[j].allocatedMemory += cache->pools[j].allocatedMemory;
+                        pools[j].allocationCount += cache->pools[j].allocationCount;
+                    }
+
+                    if (!retire)
+                        return false;
+
+                    cache->tags = {};
+                    cache->pools = {};
+                    cache->ReleasePages();
+                    return cache->detached;
+                }), mThreadCaches.end());
+        }
+
+        // Small allocations are suballocated from a page reserved by the calling thread, so the allocator
+        // mutex is only taken when that page is exhausted. Requires the cache mutex to be held.
+        GraphicsResource AllocFromThreadCache(ThreadPageCache& cache, size_t poolIndex, size_t cacheIndex, size_t size, size_t alignment)
+        {
+            auto page = cache.pages[cacheIndex];
+            if (!page || (AlignUp(page->BytesUsed(), alignment) + size) > page->Size())
+            {
+                if (page)
+                {
+                    page->Release();
+                    cache.pages[cacheIndex] = nullptr;
+                }
+
+                {
+                    ScopedLock lock(mMutex);
+
+                    page = nullptr;
+                    if (cacheIndex == RingCacheIndex)
+                    {
+                        assert(mRing != nullptr);
+                        page = mRing->ReserveChunk();
+                        if (!page)
+                        {
+                            // Every chunk has been used since the last Commit, or the GPU still has the next one
+                            ++mRingFallbacks;
+                        }
+                    }
+
+                    if (!page)
+                    {
+                        auto& allocator = mPools[poolIndex];
+                        assert(allocator != nullptr);
+
+                        page = allocator->ReservePage();
+                    }
+                }
+
+                if (!page)
+                {
+                    DebugTrace("GraphicsMemory failed to allocate page (%zu requested bytes, %zu alignment)\n", size, alignment);
+                    throw std::bad_alloc();
+                }
+
+                cache.pages[cacheIndex] = page;
+            }
+
+            return MakeResource(page, size, alignment);
+        }
     };
 
+    //--------------------------------------------------------------------------------------
+    // Frame history CSV export
+    //--------------------------------------------------------------------------------------
+    const char* const c_TagNames[TagCount] =
+    {
+        "generic", "constant", "vertex", "index", "sprites", "texture", "compute", "tag7",
+    };
+
+    std::string GetFrameHistoryCSV(_In_reads_(count) const GraphicsMemoryFrameStatistics* frames, size_t count)
+    {
+        std::string csv = "frame,committedMemory,totalMemory,totalPages";
+
+        for (size_t j = 0; j < TagCount; ++j)
+        {
+            csv += ',';
+            csv += c_TagNames[j];
+            csv += "Bytes,";
+            csv += c_TagNames[j];
+            csv += "Count";
+        }
+
+        for (size_t j = 0; j < PoolCount; ++j)
+        {
+            std::string name;
+            if (j < AllocatorPoolCount)
+            {
+                name = "pool" + std::to_string(j);
+            }
+            else if (j < RingPoolIndex)
+            {
+                name = "slot" + std::to_string(MinSizeClass << (j - AllocatorPoolCount));
+            }
+            else
+            {
+                name = "ring";
+            }
+
+            csv += ',' + name + "Bytes," + name + "Count";
+        }
+
+        csv += "\r\n";
+
+        for (size_t k = 0; k < count; ++k)
+        {
+            const auto& frame = frames[k];
+
+            csv += std::to_string(frame.frameIndex);
+            csv += ',' + std::to_string(frame.committedMemory);
+            csv += ',' + std::to_string(frame.totalMemory);
+            csv += ',' + std::to_string(frame.totalPages);
+
+            for (const auto& tag : frame.tags)
+            {
+                csv += ',' + std::to_string(tag.allocatedMemory);
+                csv += ',' + std::to_string(tag.allocationCount);
+            }
+
+            for (const auto& pool : frame.pools)
+            {
+                csv += ',' + std::to_string(pool.allocatedMemory);
+                csv += ',' + std::to_string(pool.allocationCount);
+            }
+
+            csv += "\r\n";
+        }
+
+        return csv;
+    }
+
 #ifdef USING_PIX_CUSTOM_MEMORY_EVENTS
     constexpr uint16_t c_PIXAllocatorID = 1001;
 #endif
@@ -233,6 +826,8 @@ class GraphicsMemory::Impl
 public:
     Impl(GraphicsMemory* owner) noexcept(false)
         : mOwner(owner)
+        , mFlags(GRAPHICS_MEMORY_DEFAULT)
+        , mRingBufferSize(0)
         , m_peakCommited(0)
         , m_peakBytes(0)
         , m_peakPages(0)
@@ -270,9 +865,11 @@ public:
         mDeviceAllocator.reset();
     }
 
-    void Initialize(_In_ ID3D12Device* device)
+    void Initialize(_In_ ID3D12Device* device, GRAPHICS_MEMORY_FLAGS flags, size_t ringBufferSize)
     {
-        mDeviceAllocator = std::make_unique<DeviceAllocator>(device);
+        mDeviceAllocator = std::make_unique<DeviceAllocator>(device, flags, ringBufferSize);
+        mFlags = flags;
+        mRingBufferSize = ringBufferSize;
 
     #if !(defined(_XBOX_ONE) && defined(_TITLE)) && !defined(_GAMING_XBOX)
         if (s_graphicsMemory.find(device) != s_graphicsMemory.cend())
@@ -283,9 +880,19 @@ public:
     #endif
     }
 
-    GraphicsResource Allocate(size_t size, size_t alignment)
+    GraphicsResource Allocate(size_t size, size_t alignment, uint32_t tag)
+    {
+        return mDeviceAllocator->Alloc(size, alignment, tag);
+    }
+
+    void StartTrace()
     {
-        return mDeviceAllocator->Alloc(size, alignment);
+        mDeviceAllocator->StartTrace();
+    }
+
+    std::vector<uint8_t> StopTrace()
+    {
+        return mDeviceAllocator->StopTrace();
     }
 
     void Commit(_In_ ID3D12CommandQueue* commandQueue)
@@ -298,6 +905,21 @@ public:
         mDeviceAllocator->GarbageCollect();
     }
 
+    void SetPageRetention(uint32_t idleFrames)
+    {
+        mDeviceAllocator->SetPageRetention(idleFrames);
+    }
+
+    size_t GetPageProfile(_Out_writes_opt_(count) uint32_t* pageCounts, size_t count) const
+    {
+        return mDeviceAllocator->GetPageProfile(pageCounts, count);
+    }
+
+    void Preallocate(_In_reads_(count) const uint32_t* pageCounts, size_t count)
+    {
+        mDeviceAllocator->Preallocate(pageCounts, count);
+    }
+
     void GetStatistics(GraphicsMemoryStatistics& stats)
     {
         mDeviceAllocator->GetStatistics(stats);
@@ -326,6 +948,122 @@ public:
         m_peakCommited = 0;
         m_peakBytes = 0;
         m_peakPages = 0;
+
+        mDeviceAllocator->ResetStatistics();
+    }
+
+    size_t GetFrameHistory(_Out_writes_opt_(count) GraphicsMemoryFrameStatistics* frames, size_t count) const
+    {
+        return mDeviceAllocator->GetFrameHistory(frames, count);
+    }
+
+    GraphicsMemoryStatistics ReplayTrace(_In_reads_bytes_(traceSize) const void* trace, size_t traceSize, _In_ ID3D12CommandQueue* commandQueue)
+    {
+        if (!trace || !commandQueue)
+            throw std::invalid_argument("Invalid trace or command queue parameter");
+
+        auto ptr = static_cast<const uint8_t*>(trace);
+        auto end = ptr + traceSize;
+
+        uint32_t magic = 0;
+        if (traceSize < sizeof(magic) + 1)
+            throw std::runtime_error("Invalid GraphicsMemory trace");
+
+        for (size_t j = 0; j < sizeof(magic); ++j)
+        {
+            magic |= static_cast<uint32_t>(*ptr++) << (j * 8);
+        }
+
+        if (magic != TraceMagic || *ptr++ != TraceVersion)
+            throw std::runtime_error("Invalid GraphicsMemory trace");
+
+        // The trace is replayed into a private allocator, so the live allocator and its statistics are not disturbed
+        DeviceAllocator allocator(mDeviceAllocator->GetDevice(), mFlags, mRingBufferSize);
+
+        GraphicsMemoryStatistics stats = {};
+        size_t peakCommitted = 0;
+        size_t peakBytes = 0;
+        size_t peakPages = 0;
+
+        // Allocations are treated as transient and held only until the next Commit
+        std::vector<GraphicsResource> frame;
+        while (ptr < end)
+        {
+            switch (*ptr++)
+            {
+            case TRACE_ALLOC:
+            {
+                uint64_t size, alignment, tag;
+                if (!ReadVarint(ptr, end, size) || !ReadVarint(ptr, end, alignment) || !ReadVarint(ptr, end, tag))
+                    throw std::runtime_error("Truncated GraphicsMemory trace");
+
+                // Reject requests the allocator cannot represent, as AllocateImpl would
+                if (alignment < 4
+                    || (alignment & (alignment - 1)) != 0
+                    || size > MaxTraceAllocSize
+                    || alignment > MaxTraceAllocSize
+                    || (size + alignment) * PoolIndexScale > MaxTraceAllocSize
+                    || tag > UINT32_MAX)
+                {
+                    DebugTrace("ERROR: GraphicsMemory trace has an invalid allocation (%llu bytes, %llu alignment, tag %llu)\n", size, alignment, tag);
+                    throw std::runtime_error("Invalid GraphicsMemory trace allocation");
+                }
+
+                frame.emplace_back(allocator.Alloc(
+                    static_cast<size_t>(size),
+                    static_cast<size_t>(alignment),
+                    static_cast<uint32_t>(tag)));
+                break;
+            }
+
+            case TRACE_COMMIT:
+                frame.clear();
+                allocator.KickFences(commandQueue);
+
+                allocator.GetStatistics(stats);
+                peakCommitted = std::max(peakCommitted, stats.committedMemory);
+                peakBytes = std::max(peakBytes, stats.totalMemory);
+                peakPages = std::max(peakPages, stats.totalPages);
+                break;
+
+            default:
+                throw std::runtime_error("Invalid GraphicsMemory trace record");
+            }
+        }
+
+        frame.clear();
+
+        allocator.GetStatistics(stats);
+        stats.peakCommitedMemory = std::max(peakCommitted, stats.committedMemory);
+        stats.peakTotalMemory = std::max(peakBytes, stats.totalMemory);
+        stats.peakTotalPages = std::max(peakPages, stats.totalPages);
+
+        return stats;
+    }
+
+    void SaveFrameHistory(_In_z_ const wchar_t* fileName) const
+    {
+        if (!fileName)
+            throw std::invalid_argument("Invalid file name parameter");
+
+        std::vector<GraphicsMemoryFrameStatistics> frames(FrameHistoryCount);
+        frames.resize(mDeviceAllocator->GetFrameHistory(frames.data(), frames.size()));
+
+        const std::string csv = GetFrameHistoryCSV(frames.data(), frames.size());
+
+        ScopedHandle hFile(safe_handle(CreateFile2(
+            fileName,
+            GENERIC_WRITE, 0, CREATE_ALWAYS,
+            nullptr)));
+        if (!hFile)
+            throw std::system_error(std::error_code(static_cast<int>(GetLastError()), std::system_category()), "CreateFile2");
+
+        DWORD bytesWritten;
+        if (!WriteFile(hFile.get(), csv.data(), static_cast<DWORD>(csv.size()), &bytesWritten, nullptr))
+            throw std::system_error(std::error_code(static_cast<int>(GetLastError()), std::system_category()), "WriteFile");
+
+        if (bytesWritten != csv.size())
+            throw std::runtime_error("GraphicsMemory frame history write incomplete");
     }
 
     ID3D12Device* GetDevice() const noexcept { return mDeviceAllocator ? mDeviceAllocator->GetDevice() : nullptr; }
@@ -339,6 +1077,8 @@ public:
 
 private:
     std::unique_ptr<DeviceAllocator> mDeviceAllocator;
+    GRAPHICS_MEMORY_FLAGS mFlags;
+    size_t mRingBufferSize;
 
     size_t  m_peakCommited;
     size_t  m_peakBytes;
@@ -360,7 +1100,13 @@ std::map<ID3D12Device*, GraphicsMemory::Impl*> GraphicsMemory::Impl::s_graphicsM
 GraphicsMemory::GraphicsMemory(_In_ ID3D12Device* device)
     : pImpl(std::make_unique<Impl>(this))
 {
-    pImpl->Initialize(device);
+    pImpl->Initialize(device, GRAPHICS_MEMORY_DEFAULT, 0);
+}
+
+GraphicsMemory::GraphicsMemory(_In_ ID3D12Device* device, GRAPHICS_MEMORY_FLAGS flags, size_t ringBufferSize)
+    : pImpl(std::make_unique<Impl>(this))
+{
+    pImpl->Initialize(device, flags, ringBufferSize);
 }
 
 
@@ -386,9 +1132,15 @@ GraphicsMemory::~GraphicsMemory() = default;
 
 
 GraphicsResource GraphicsMemory::AllocateImpl(size_t size, size_t alignment)
+{
+    return AllocateImpl(size, alignment, TAG_GENERIC);
+}
+
+
+GraphicsResource GraphicsMemory::AllocateImpl(size_t size, size_t alignment, uint32_t tag)
 {
     assert(alignment >= 4); // Should use at least DWORD alignment
-    return pImpl->Allocate(size, alignment);
+    return pImpl->Allocate(size, alignment, tag);
 }
 
 
@@ -403,6 +1155,21 @@ void GraphicsMemory::GarbageCollect()
     pImpl->GarbageCollect();
 }
 
+void GraphicsMemory::SetPageRetention(uint32_t idleFrames)
+{
+    pImpl->SetPageRetention(idleFrames);
+}
+
+size_t GraphicsMemory::GetPageProfile(_Out_writes_opt_(count) uint32_t* pageCounts, size_t count) const
+{
+    return pImpl->GetPageProfile(pageCounts, count);
+}
+
+void GraphicsMemory::Preallocate(_In_reads_(count) const uint32_t* pageCounts, size_t count)
+{
+    pImpl->Preallocate(pageCounts, count);
+}
+
 GraphicsMemoryStatistics GraphicsMemory::GetStatistics()
 {
     GraphicsMemoryStatistics stats;
@@ -415,6 +1182,31 @@ void GraphicsMemory::ResetStatistics()
     pImpl->ResetStatistics();
 }
 
+size_t GraphicsMemory::GetFrameHistory(_Out_writes_opt_(count) GraphicsMemoryFrameStatistics* frames, size_t count) const
+{
+    return pImpl->GetFrameHistory(frames, count);
+}
+
+void GraphicsMemory::SaveFrameHistory(_In_z_ const wchar_t* fileName) const
+{
+    pImpl->SaveFrameHistory(fileName);
+}
+
+void GraphicsMemory::StartTrace()
+{
+    pImpl->StartTrace();
+}
+
+std::vector<uint8_t> GraphicsMemory::StopTrace()
+{
+    return pImpl->StopTrace();
+}
+
+GraphicsMemoryStatistics GraphicsMemory::ReplayTrace(_In_reads_bytes_(traceSize) const void* trace, size_t traceSize, _In_ ID3D12CommandQueue* commandQueue)
+{
+    return pImpl->ReplayTrace(trace, traceSize, commandQueue);
+}
+
 ID3D12Device* GraphicsMemory::GetDevice() const noexcept
 {
     if (!pImpl)
@@ -27,22 +27,31 @@ LinearAllocatorPage::LinearAllocatorPage() noexcept
     , pNextPage(nullptr)
     , mMemory(nullptr)
     , mPendingFence(0)
+    , mReserved(false)
     , mGpuAddress{}
+    , mResourceOffset(0)
+    , mHeapSlot(0)
+    , mLastUsedFrame(0)
     , mOffset(0)
     , mSize(0)
     , mRefCount(1)
+    , mBytesRequested(0)
 {}
 
 size_t LinearAllocatorPage::Suballocate(_In_ size_t size, _In_ size_t alignment)
 {
-    const size_t offset = AlignUp(mOffset, alignment);
+    const size_t offset = AlignUp(mOffset.load(std::memory_order_relaxed), alignment);
     if (offset + size > mSize)
     {
         // Use of suballocate should be limited to pages with free space,
         // so really shouldn't happen.
         throw std::runtime_error("LinearAllocatorPage::Suballocate");
     }
-    mOffset = offset + size;
+
+    // Only the thread suballocating from the page writes these, but they may be read from any thread
+    mOffset.store(offset + size, std::memory_order_relaxed);
+    mBytesRequested.store(mBytesRequested.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+
     return offset;
 }
 
@@ -53,23 +62,92 @@ void LinearAllocatorPage::Release() noexcept
     if (mRefCount.fetch_sub(1) == 1)
     {
         mUploadResource->Unmap(0, nullptr);
+
+        if (mHeap)
+        {
+            // Destroy the placed resource before its heap range can be reused
+            mUploadResource.Reset();
+            mHeap->FreeSlot(mHeapSlot);
+        }
+
         delete this;
     }
 }
 
 
+//--------------------------------------------------------------------------------------
+LinearAllocatorHeap::LinearAllocatorHeap(
+    _In_ ID3D12Device* pDevice,
+    _In_ size_t heapSize,
+    _In_ size_t slotSize) noexcept(false)
+    : m_slotSize(slotSize)
+    , m_slotCount(heapSize / slotSize)
+{
+    assert(pDevice != nullptr);
+    assert(slotSize > 0 && (slotSize % D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT) == 0);
+    assert(m_slotCount > 0);
+
+    const CD3DX12_HEAP_DESC heapDesc(
+        static_cast<UINT64>(m_slotCount * slotSize),
+        D3D12_HEAP_TYPE_UPLOAD,
+        D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT,
+        D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS);
+
+    ThrowIfFailed(pDevice->CreateHeap(&heapDesc, IID_GRAPHICS_PPV_ARGS(m_heap.GetAddressOf())));
+
+    SetDebugObjectName(m_heap.Get(), L"LinearAllocatorHeap");
+
+    // Hand out the lowest slots first
+    m_freeSlots.reserve(m_slotCount);
+    for (size_t j = m_slotCount; j > 0; --j)
+    {
+        m_freeSlots.push_back(j - 1);
+    }
+}
+
+bool LinearAllocatorHeap::AllocateSlot(size_t& slot) noexcept
+{
+    const std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_freeSlots.empty())
+        return false;
+
+    slot = m_freeSlots.back();
+    m_freeSlots.pop_back();
+    return true;
+}
+
+void LinearAllocatorHeap::FreeSlot(size_t slot) noexcept
+{
+    const std::lock_guard<std::mutex> lock(m_mutex);
+
+    assert(slot < m_slotCount);
+    assert(m_freeSlots.size() < m_slotCount);
+    m_freeSlots.push_back(slot);
+}
+
+bool LinearAllocatorHeap::IsEmpty() const noexcept
+{
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    return m_freeSlots.size() == m_slotCount;
+}
+
+
 //--------------------------------------------------------------------------------------
 LinearAllocator::LinearAllocator(
     _In_ ID3D12Device* pDevice,
     _In_ size_t pageSize,
-    _In_ size_t preallocateBytes) noexcept(false)
-    : m_pendingPages(nullptr)
-    , m_usedPages(nullptr)
+    _In_ size_t preallocateBytes,
+    _In_ size_t heapSize) noexcept(false)
+    : m_usedPages(nullptr)
     , m_unusedPages(nullptr)
     , m_increment(pageSize)
+    , m_heapSize((heapSize >= pageSize) ? heapSize : 0)
     , m_numPending(0)
     , m_totalPages(0)
     , m_fenceCount(0)
+    , m_frameCount(0)
+    , m_usageHistory{}
     , m_device(pDevice)
 {
     assert(pDevice != nullptr);
@@ -97,18 +175,17 @@ LinearAllocator::LinearAllocator(
 LinearAllocator::~LinearAllocator()
 {
     // Must wait for all pending fences!
-    while (m_pendingPages != nullptr)
+    while (!m_pendingBuckets.empty())
     {
         RetirePendingPages();
     }
 
-    assert(m_pendingPages == nullptr);
+    assert(m_numPending == 0);
 
     // Return all the memory
     FreePages(m_unusedPages);
     FreePages(m_usedPages);
 
-    m_pendingPages = nullptr;
     m_usedPages = nullptr;
     m_unusedPages = nullptr;
     m_increment = 0;
@@ -134,16 +211,40 @@ LinearAllocatorPage* LinearAllocator::FindPageForAlloc(_In_ size_t size, _In_ si
     return page;
 }
 
+LinearAllocatorPage* LinearAllocator::ReservePage()
+{
+    auto page = GetCleanPageForAlloc();
+    if (!page)
+    {
+        return nullptr;
+    }
+
+    page->mReserved = true;
+    page->AddRef();
+
+    return page;
+}
+
 // Call this after you submit your work to the driver.
 void LinearAllocator::FenceCommittedPages(_In_ ID3D12CommandQueue* commandQueue)
 {
+    // Record how many pages this frame needed for the retention policy
+    const size_t frameSlot = static_cast<size_t>(m_frameCount++ % m_usageHistory.size());
+    m_usageHistory[frameSlot] = m_numPending;
+    for (auto page = m_usedPages; page != nullptr; page = page->pNextPage)
+    {
+        ++m_usageHistory[frameSlot];
+    }
+
     // No pending pages
     if (m_usedPages == nullptr)
         return;
 
-    // For all the used pages, fence them
-    UINT numReady = 0;
+    // For all the used pages, fence them with a single value for this batch
+    const uint64_t fenceValue = m_fenceCount + 1;
+    size_t numReady = 0;
     LinearAllocatorPage* readyPages = nullptr;
+    LinearAllocatorPage* readyTail = nullptr;
     LinearAllocatorPage* unreadyPages = nullptr;
     LinearAllocatorPage* nextPage = nullptr;
     for (auto page = m_usedPages; page != nullptr; page = nextPage)
@@ -156,14 +257,13 @@ void LinearAllocator::FenceCommittedPages(_In_ ID3D12CommandQueue* commandQueue)
         // This implies the allocator is the only remaining reference to the page, and therefore the memory is ready for re-use.
         if (page->RefCount() == 1)
         {
-            // Signal the fence
             numReady++;
-            page->mPendingFence = ++m_fenceCount;
-            ThrowIfFailed(commandQueue->Signal(m_fence.Get(), m_fenceCount));
+            page->mPendingFence = fenceValue;
 
             // Link to the ready pages list
             page->pNextPage = readyPages;
             if (readyPages) readyPages->pPrevPage = page;
+            else readyTail = page;
             readyPages = page;
         }
         else
@@ -178,11 +278,14 @@ void LinearAllocator::FenceCommittedPages(_In_ ID3D12CommandQueue* commandQueue)
     // Replace the used pages list with the new unready list
     m_usedPages = unreadyPages;
 
-    // Append all those pages from the ready list to the pending list
+    // The ready list becomes a new retirement bucket for this fence value
     if (numReady > 0)
     {
+        m_fenceCount = fenceValue;
+        ThrowIfFailed(commandQueue->Signal(m_fence.Get(), m_fenceCount));
+
         m_numPending += numReady;
-        LinkPageChain(readyPages, m_pendingPages);
+        m_pendingBuckets.push_back({ fenceValue, readyPages, readyTail, numReady });
     }
 
 #if VALIDATE_LISTS
@@ -194,25 +297,41 @@ void LinearAllocator::FenceCommittedPages(_In_ ID3D12CommandQueue* commandQueue)
 // (immediately before or after Present-time)
 void LinearAllocator::RetirePendingPages() noexcept
 {
+    if (m_pendingBuckets.empty())
+        return;
+
     const uint64_t fenceValue = m_fence->GetCompletedValue();
 
-    // For each page that we know has a fence pending, check it. If the fence has passed,
-    // we can mark the page for re-use.
-    auto page = m_pendingPages;
-    while (page != nullptr)
+    // Buckets are fenced in order, so stop at the first one the GPU has not reached. Each retired
+    // bucket is spliced onto the unused list as a whole, and pages are reset when they are reused.
+    while (!m_pendingBuckets.empty() && fenceValue >= m_pendingBuckets.front().fenceValue)
     {
-        auto nextPage = page->pNextPage;
+        const PendingBucket& bucket = m_pendingBuckets.front();
 
-        assert(page->mPendingFence != 0);
+        assert(bucket.head != nullptr && bucket.tail != nullptr);
+        assert(bucket.head->pPrevPage == nullptr && bucket.tail->pNextPage == nullptr);
 
-        if (fenceValue >= page->mPendingFence)
+        // A page may have been held by a live allocation for many frames, so its idle time for
+        // Shrink starts now rather than when it was taken from the unused list.
+        for (auto page = bucket.head; page != nullptr; page = page->pNextPage)
         {
-            // Fence has passed. It is safe to use this page again.
-            ReleasePage(page);
+            page->mLastUsedFrame = m_frameCount;
         }
 
-        page = nextPage;
+        bucket.tail->pNextPage = m_unusedPages;
+        if (m_unusedPages)
+            m_unusedPages->pPrevPage = bucket.tail;
+        m_unusedPages = bucket.head;
+
+        assert(m_numPending >= bucket.pageCount);
+        m_numPending -= bucket.pageCount;
+
+        m_pendingBuckets.pop_front();
     }
+
+#if VALIDATE_LISTS
+    ValidatePageLists();
+#endif
 }
 
 void LinearAllocator::Shrink() noexcept
@@ -220,11 +339,108 @@ void LinearAllocator::Shrink() noexcept
     FreePages(m_unusedPages);
     m_unusedPages = nullptr;
 
+    ReleaseEmptyHeaps();
+
+#if VALIDATE_LISTS
+    ValidatePageLists();
+#endif
+}
+
+void LinearAllocator::Shrink(uint32_t idleFrames) noexcept
+{
+    if (!idleFrames)
+    {
+        Shrink();
+        return;
+    }
+
+    // Keep enough pages to cover the recent peak, and only free those that have been idle long enough
+    const size_t highWater = PeakPageCount();
+
+    LinearAllocatorPage* nextPage = nullptr;
+    for (auto page = m_unusedPages; page != nullptr && m_totalPages > highWater; page = nextPage)
+    {
+        nextPage = page->pNextPage;
+
+        if ((m_frameCount - page->mLastUsedFrame) >= idleFrames)
+        {
+            UnlinkPage(page);
+            page->Release();
+
+            assert(m_totalPages > 0);
+            m_totalPages--;
+        }
+    }
+
+    ReleaseEmptyHeaps();
+
 #if VALIDATE_LISTS
     ValidatePageLists();
 #endif
 }
 
+void LinearAllocator::ReleaseEmptyHeaps() noexcept
+{
+    // Release heaps which no longer have any pages placed in them
+    m_heaps.erase(
+        std::remove_if(m_heaps.begin(), m_heaps.end(),
+            [](const std::shared_ptr<LinearAllocatorHeap>& heap) noexcept
+            {
+                return heap.use_count() == 1 && heap->IsEmpty();
+            }),
+        m_heaps.end());
+}
+
+void LinearAllocator::Preallocate(size_t pageCount)
+{
+    while (m_totalPages < pageCount)
+    {
+        if (GetNewPage() == nullptr)
+        {
+            DebugTrace("LinearAllocator failed to preallocate pages (%zu required bytes, %zu pages)\n",
+                pageCount * m_increment, pageCount);
+            throw std::bad_alloc();
+        }
+    }
+}
+
+size_t LinearAllocator::PeakPageCount() const noexcept
+{
+    size_t peak = 0;
+    for (auto count : m_usageHistory)
+    {
+        peak = std::max(peak, count);
+    }
+    return peak;
+}
+
+size_t LinearAllocator::InUseMemoryUsage() const noexcept
+{
+    size_t count = m_numPending;
+    for (auto page = m_usedPages; page != nullptr; page = page->pNextPage)
+    {
+        ++count;
+    }
+    return count * m_increment;
+}
+
+size_t LinearAllocator::RequestedMemoryUsage() const noexcept
+{
+    size_t bytes = 0;
+    for (auto page = m_usedPages; page != nullptr; page = page->pNextPage)
+    {
+        bytes += page->BytesRequested();
+    }
+    for (auto& bucket : m_pendingBuckets)
+    {
+        for (auto page = bucket.head; page != nullptr; page = page->pNextPage)
+        {
+            bytes += page->BytesRequested();
+        }
+    }
+    return bytes;
+}
+
 LinearAllocatorPage* LinearAllocator::GetCleanPageForAlloc()
 {
     // Grab the first unused page, if one exists. Else, allocate a new page.
@@ -243,7 +459,8 @@ LinearAllocatorPage* LinearAllocator::GetCleanPageForAlloc()
     UnlinkPage(page);
     LinkPage(page, m_usedPages);
 
-    assert(page->mOffset == 0);
+    ResetPage(page);
+    page->mLastUsedFrame = m_frameCount;
 
     return page;
 }
@@ -275,7 +492,11 @@ LinearAllocatorPage* LinearAllocator::FindPageForAlloc(
 {
     for (auto page = list; page != nullptr; page = page->pNextPage)
     {
-        const size_t offset = AlignUp(page->mOffset, alignment);
+        // Pages reserved by a thread are suballocated without taking any locks
+        if (page->mReserved)
+            continue;
+
+        const size_t offset = AlignUp(page->BytesUsed(), alignment);
         if (offset + sizeBytes <= m_increment)
             return page;
     }
@@ -284,18 +505,73 @@ LinearAllocatorPage* LinearAllocator::FindPageForAlloc(
 
 LinearAllocatorPage* LinearAllocator::GetNewPage()
 {
-    const CD3DX12_HEAP_PROPERTIES uploadHeapProperties(D3D12_HEAP_TYPE_UPLOAD);
     const CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(m_increment);
 
-    // Allocate the upload heap
     ComPtr<ID3D12Resource> spResource;
-    HRESULT hr = m_device->CreateCommittedResource(
-        &uploadHeapProperties,
-        D3D12_HEAP_FLAG_NONE,
-        &bufferDesc,
-        D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr,
-        IID_GRAPHICS_PPV_ARGS(spResource.ReleaseAndGetAddressOf()));
+    std::shared_ptr<LinearAllocatorHeap> heap;
+    size_t heapSlot = 0;
+
+    HRESULT hr = E_FAIL;
+    if (m_heapSize > 0)
+    {
+        // Place the page in an existing heap with a free slot, or create another heap
+        for (auto& it : m_heaps)
+        {
+            if (it->AllocateSlot(heapSlot))
+            {
+                heap = it;
+                break;
+            }
+        }
+
+        if (!heap)
+        {
+            try
+            {
+                auto newHeap = std::make_shared<LinearAllocatorHeap>(m_device.Get(), m_heapSize, m_increment);
+                if (newHeap->AllocateSlot(heapSlot))
+                {
+                    m_heaps.push_back(newHeap);
+                    heap = std::move(newHeap);
+                }
+            }
+            catch (const std::exception&)
+            {
+                DebugTrace("LinearAllocator::GetNewPage failed to create heap, using committed resource\n");
+            }
+        }
+
+        if (heap)
+        {
+            hr = m_device->CreatePlacedResource(
+                heap->Heap(),
+                static_cast<UINT64>(heapSlot * m_increment),
+                &bufferDesc,
+                D3D12_RESOURCE_STATE_GENERIC_READ,
+                nullptr,
+                IID_GRAPHICS_PPV_ARGS(spResource.ReleaseAndGetAddressOf()));
+            if (FAILED(hr))
+            {
+                heap->FreeSlot(heapSlot);
+                heap.reset();
+            }
+        }
+    }
+
+    if (!heap)
+    {
+        const CD3DX12_HEAP_PROPERTIES uploadHeapProperties(D3D12_HEAP_TYPE_UPLOAD);
+
+        // Allocate the upload heap
+        hr = m_device->CreateCommittedResource(
+            &uploadHeapProperties,
+            D3D12_HEAP_FLAG_NONE,
+            &bufferDesc,
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr,
+            IID_GRAPHICS_PPV_ARGS(spResource.ReleaseAndGetAddressOf()));
+    }
+
     if (FAILED(hr))
     {
         if (hr != E_OUTOFMEMORY)
@@ -320,6 +596,8 @@ LinearAllocatorPage* LinearAllocator::GetNewPage()
     page->mGpuAddress = spResource->GetGPUVirtualAddress();
     page->mSize = m_increment;
     page->mUploadResource.Swap(spResource);
+    page->mHeap = std::move(heap);
+    page->mHeapSlot = heapSlot;
 
     // Set as head of the list
     page->pNextPage = m_unusedPages;
@@ -344,8 +622,6 @@ void LinearAllocator::UnlinkPage(LinearAllocatorPage* page) noexcept
         m_unusedPages = page->pNextPage;
     else if (page == m_usedPages)
         m_usedPages = page->pNextPage;
-    else if (page == m_pendingPages)
-        m_pendingPages = page->pNextPage;
 
     if (page->pNextPage)
         page->pNextPage->pPrevPage = page->pPrevPage;
@@ -358,33 +634,6 @@ void LinearAllocator::UnlinkPage(LinearAllocatorPage* page) noexcept
 #endif
 }
 
-void LinearAllocator::LinkPageChain(LinearAllocatorPage* page, LinearAllocatorPage*& list) noexcept
-{
-#if VALIDATE_LISTS
-    // Walk the chain and ensure it's not in the list twice
-    for (LinearAllocatorPage* cur = list; cur != nullptr; cur = cur->pNextPage)
-    {
-        assert(cur != page);
-    }
-#endif
-    assert(page->pPrevPage == nullptr);
-    assert(list == nullptr || list->pPrevPage == nullptr);
-
-    // Follow chain to the end and append
-    LinearAllocatorPage* lastPage = nullptr;
-    for (lastPage = page; lastPage->pNextPage != nullptr; lastPage = lastPage->pNextPage) {}
-
-    lastPage->pNextPage = list;
-    if (list)
-        list->pPrevPage = lastPage;
-
-    list = page;
-
-#if VALIDATE_LISTS
-    ValidatePageLists();
-#endif
-}
-
 void LinearAllocator::LinkPage(LinearAllocatorPage* page, LinearAllocatorPage*& list) noexcept
 {
 #if VALIDATE_LISTS
@@ -409,24 +658,20 @@ void LinearAllocator::LinkPage(LinearAllocatorPage* page, LinearAllocatorPage*&
 #endif
 }
 
-void LinearAllocator::ReleasePage(LinearAllocatorPage* page) noexcept
+void LinearAllocator::ResetPage(LinearAllocatorPage* page) noexcept
 {
-    assert(m_numPending > 0);
-    m_numPending--;
-
-    UnlinkPage(page);
-    LinkPage(page, m_unusedPages);
-
     // Reset the page offset (effectively erasing the memory)
-    page->mOffset = 0;
-
 #ifdef _DEBUG
-    memset(page->mMemory, 0, m_increment);
+    if (page->BytesUsed() > 0)
+    {
+        memset(page->mMemory, 0, m_increment);
+    }
 #endif
 
-#if VALIDATE_LISTS
-    ValidatePageLists();
-#endif
+    page->mOffset.store(0, std::memory_order_relaxed);
+    page->mPendingFence = 0;
+    page->mReserved = false;
+    page->mBytesRequested.store(0, std::memory_order_relaxed);
 }
 
 void LinearAllocator::FreePages(LinearAllocatorPage* page) noexcept
@@ -459,7 +704,10 @@ void LinearAllocator::ValidateList(LinearAllocatorPage* list)
 
 void LinearAllocator::ValidatePageLists()
 {
-    ValidateList(m_pendingPages);
+    for (auto& bucket : m_pendingBuckets)
+    {
+        ValidateList(bucket.head);
+    }
     ValidateList(m_usedPages);
     ValidateList(m_unusedPages);
 }
@@ -482,7 +730,10 @@ void LinearAllocator::SetDebugName(const wchar_t* name)
 
     // Rename existing pages
     m_fence->SetName(name);
-    SetPageDebugName(m_pendingPages);
+    for (auto& bucket : m_pendingBuckets)
+    {
+        SetPageDebugName(bucket.head);
+    }
     SetPageDebugName(m_usedPages);
     SetPageDebugName(m_unusedPages);
 }
@@ -495,3 +746,207 @@ void LinearAllocator::SetPageDebugName(LinearAllocatorPage* list) noexcept
     }
 }
 #endif
+
+
+//--------------------------------------------------------------------------------------
+namespace
+{
+    // Marks a chunk that has been handed out since it was last fenced
+    constexpr uint64_t c_activeChunkFence = UINT64_MAX;
+}
+
+RingAllocator::RingAllocator(
+    _In_ ID3D12Device* pDevice,
+    _In_ size_t chunkSize,
+    _In_ size_t ringSize) noexcept(false)
+    : m_chunkSize(chunkSize)
+    , m_head(0)
+    , m_stalls(0)
+    , m_fenceCount(0)
+{
+    assert(pDevice != nullptr);
+    assert(chunkSize > 0);
+
+    const size_t chunkCount = std::max<size_t>(1, (ringSize + chunkSize - 1) / chunkSize);
+    const size_t totalSize = chunkCount * chunkSize;
+
+    const CD3DX12_HEAP_PROPERTIES uploadHeapProperties(D3D12_HEAP_TYPE_UPLOAD);
+    const CD3DX12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(totalSize);
+
+    ComPtr<ID3D12Resource> spResource;
+    ThrowIfFailed(pDevice->CreateCommittedResource(
+        &uploadHeapProperties,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_GRAPHICS_PPV_ARGS(spResource.GetAddressOf())));
+
+    SetDebugObjectName(spResource.Get(), L"RingAllocator");
+
+    ThrowIfFailed(pDevice->CreateFence(
+        0,
+        D3D12_FENCE_FLAG_NONE,
+        IID_GRAPHICS_PPV_ARGS(m_fence.ReleaseAndGetAddressOf())));
+
+    SetDebugObjectName(m_fence.Get(), L"RingAllocator");
+
+    m_event.reset(CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE));
+    if (!m_event)
+        throw std::system_error(std::error_code(static_cast<int>(GetLastError()), std::system_category()), "CreateEventEx");
+
+    const D3D12_GPU_VIRTUAL_ADDRESS gpuAddress = spResource->GetGPUVirtualAddress();
+
+    // Each chunk maps the resource so it can be released independently like a page
+    m_chunks.reserve(chunkCount);
+    for (size_t j = 0; j < chunkCount; ++j)
+    {
+        void* pMemory = nullptr;
+        ThrowIfFailed(spResource->Map(0, nullptr, &pMemory));
+
+        const size_t offset = j * chunkSize;
+
+        auto chunk = new LinearAllocatorPage;
+        chunk->mMemory = static_cast<uint8_t*>(pMemory) + offset;
+        chunk->mGpuAddress = gpuAddress + offset;
+        chunk->mResourceOffset = offset;
+        chunk->mSize = chunkSize;
+        chunk->mUploadResource = spResource;
+        m_chunks.push_back(chunk);
+
+        if (!j)
+        {
+            memset(pMemory, 0, totalSize);
+        }
+    }
+
+    m_activeChunks.reserve(chunkCount);
+}
+
+RingAllocator::~RingAllocator()
+{
+    // Must wait for all pending fences!
+    if (m_fenceCount > 0 && m_fence)
+    {
+        try
+        {
+            WaitForFence(m_fenceCount);
+        }
+        catch (...)
+        {
+            DebugTrace("ERROR: RingAllocator failed waiting for pending fences\n");
+        }
+    }
+
+    // Chunks still referenced by a GraphicsResource are freed when that handle is released
+    for (auto chunk : m_chunks)
+    {
+        chunk->Release();
+    }
+
+    m_chunks.clear();
+    m_activeChunks.clear();
+}
+
+LinearAllocatorPage* RingAllocator::ReserveChunk()
+{
+    const size_t chunkCount = m_chunks.size();
+
+    const uint64_t completedValue = m_fence->GetCompletedValue();
+
+    for (size_t j = 0; j < chunkCount; ++j)
+    {
+        auto chunk = m_chunks[m_head];
+
+        // Skip chunks that are still referenced or already used since the last fence
+        if (chunk->RefCount() > 1 || chunk->mPendingFence == c_activeChunkFence)
+        {
+            m_head = (m_head + 1) % chunkCount;
+            continue;
+        }
+
+        if (chunk->mPendingFence > completedValue)
+        {
+            // The producer has caught up with the GPU. The caller holds the allocator lock,
+            // so rather than waiting here it falls back to the page pools.
+            ++m_stalls;
+            return nullptr;
+        }
+
+        m_head = (m_head + 1) % chunkCount;
+
+        chunk->mPendingFence = c_activeChunkFence;
+        chunk->mOffset.store(0, std::memory_order_relaxed);
+        chunk->mBytesRequested.store(0, std::memory_order_relaxed);
+        chunk->AddRef();
+
+        m_activeChunks.push_back(chunk);
+
+        return chunk;
+    }
+
+    return nullptr;
+}
+
+void RingAllocator::FenceCommittedChunks(_In_ ID3D12CommandQueue* commandQueue)
+{
+    if (m_activeChunks.empty())
+        return;
+
+    // Chunks that are still referenced will be fenced once they are released
+    const uint64_t fenceValue = m_fenceCount + 1;
+    auto it = std::remove_if(m_activeChunks.begin(), m_activeChunks.end(),
+        [fenceValue](LinearAllocatorPage* chunk) noexcept
+        {
+            if (chunk->RefCount() > 1)
+                return false;
+
+            chunk->mPendingFence = fenceValue;
+            return true;
+        });
+
+    if (it == m_activeChunks.end())
+        return;
+
+    m_activeChunks.erase(it, m_activeChunks.end());
+
+    m_fenceCount = fenceValue;
+    ThrowIfFailed(commandQueue->Signal(m_fence.Get(), m_fenceCount));
+}
+
+size_t RingAllocator::CommittedMemoryUsage() const noexcept
+{
+    const uint64_t completedValue = m_fence->GetCompletedValue();
+
+    size_t count = 0;
+    for (auto chunk : m_chunks)
+    {
+        if (chunk->mPendingFence != c_activeChunkFence && chunk->mPendingFence > completedValue)
+        {
+            ++count;
+        }
+    }
+
+    return count * m_chunkSize;
+}
+
+void RingAllocator::WaitForFence(uint64_t fenceValue)
+{
+    if (m_fence->GetCompletedValue() >= fenceValue)
+        return;
+
+    ThrowIfFailed(m_fence->SetEventOnCompletion(fenceValue, m_event.get()));
+
+    const DWORD wr = WaitForSingleObjectEx(m_event.get(), INFINITE, FALSE);
+    if (wr != WAIT_OBJECT_0)
+    {
+        if (wr == WAIT_FAILED)
+        {
+            throw std::system_error(std::error_code(static_cast<int>(GetLastError()), std::system_category()), "WaitForSingleObjectEx");
+        }
+        else
+        {
+            throw std::runtime_error("WaitForSingleObjectEx");
+        }
+    }
+}
@@ -42,11 +42,44 @@
 
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <deque>
 
 
 namespace DirectX
 {
+    // A large upload heap which LinearAllocator pages are placed into, split into page-sized slots.
+    // Slots are returned when the last reference to a page is released, which may happen on any thread.
+    class LinearAllocatorHeap
+    {
+    public:
+        LinearAllocatorHeap(
+            _In_ ID3D12Device* pDevice,
+            _In_ size_t heapSize,
+            _In_ size_t slotSize) noexcept(false);
+
+        LinearAllocatorHeap(LinearAllocatorHeap&&) = delete;
+        LinearAllocatorHeap& operator= (LinearAllocatorHeap&&) = delete;
+
+        LinearAllocatorHeap(LinearAllocatorHeap const&) = delete;
+        LinearAllocatorHeap& operator=(LinearAllocatorHeap const&) = delete;
+
+        bool AllocateSlot(_Out_ size_t& slot) noexcept;
+        void FreeSlot(size_t slot) noexcept;
+        bool IsEmpty() const noexcept;
+
+        ID3D12Heap* Heap() const noexcept { return m_heap.Get(); }
+        size_t SlotSize() const noexcept { return m_slotSize; }
+
+    private:
+        Microsoft::WRL::ComPtr<ID3D12Heap>      m_heap;
+        mutable std::mutex                      m_mutex;
+        std::vector<size_t>                     m_freeSlots;
+        size_t                                  m_slotSize;
+        size_t                                  m_slotCount;
+    };
+
     class LinearAllocatorPage
     {
     public:
@@ -63,7 +96,9 @@ namespace DirectX
         void* BaseMemory() const noexcept { return mMemory; }
         ID3D12Resource* UploadResource() const noexcept { return mUploadResource.Get(); }
         D3D12_GPU_VIRTUAL_ADDRESS GpuAddress() const noexcept { return mGpuAddress; }
-        size_t BytesUsed() const noexcept { return mOffset; }
+        size_t ResourceOffset() const noexcept { return mResourceOffset; }
+        size_t BytesUsed() const noexcept { return mOffset.load(std::memory_order_relaxed); }
+        size_t BytesRequested() const noexcept { return mBytesRequested.load(std::memory_order_relaxed); }
         size_t Size() const noexcept { return mSize; }
 
         void AddRef() noexcept { mRefCount.fetch_add(1); }
@@ -72,19 +107,26 @@ namespace DirectX
 
     protected:
         friend class LinearAllocator;
+        friend class RingAllocator;
 
         LinearAllocatorPage*                    pPrevPage;
         LinearAllocatorPage*                    pNextPage;
 
         void*                                   mMemory;
         uint64_t                                mPendingFence;
+        bool                                    mReserved;
         D3D12_GPU_VIRTUAL_ADDRESS               mGpuAddress;
-        size_t                                  mOffset;
+        size_t                                  mResourceOffset;
+        size_t                                  mHeapSlot;
+        uint64_t                                mLastUsedFrame;
+        std::atomic<size_t>                     mOffset;    // Reserved pages are suballocated while other threads may read this
         size_t                                  mSize;
         Microsoft::WRL::ComPtr<ID3D12Resource>  mUploadResource;
+        std::shared_ptr<LinearAllocatorHeap>    mHeap;
 
     private:
         std::atomic<int32_t>                    mRefCount;
+        std::atomic<size_t>                     mBytesRequested;
     };
 
     class LinearAllocator
@@ -93,10 +135,14 @@ namespace DirectX
         // These values will be rounded up to the nearest 64k.
         // You can specify zero for incrementalSizeBytes to increment
         // by 1 page (64k).
+        //
+        // If heapSize is non-zero, pages are created as placed resources in upload heaps of
+        // that size rather than as individual committed resources.
         LinearAllocator(
             _In_ ID3D12Device* pDevice,
             _In_ size_t pageSize,
-            _In_ size_t preallocateBytes = 0) noexcept(false);
+            _In_ size_t preallocateBytes = 0,
+            _In_ size_t heapSize = 0) noexcept(false);
 
         LinearAllocator(LinearAllocator&&) = default;
         LinearAllocator& operator= (LinearAllocator&&) = default;
@@ -108,6 +154,11 @@ namespace DirectX
 
         LinearAllocatorPage* FindPageForAlloc(_In_ size_t requestedSize, _In_ size_t alignment);
 
+        // Returns a clean page for the exclusive use of a single thread. Reserved pages are
+        // never returned by FindPageForAlloc, and the caller owns an additional reference
+        // which must be released before the page can be fenced.
+        LinearAllocatorPage* ReservePage();
+
         // Call this at least once a frame to check if pages have become available.
         void RetirePendingPages() noexcept;
 
@@ -118,11 +169,23 @@ namespace DirectX
         // Throws away all currently unused pages
         void Shrink() noexcept;
 
+        // Throws away unused pages which have not been used for idleFrames calls to
+        // FenceCommittedPages, keeping at least PeakPageCount pages. Zero frees all unused pages.
+        void Shrink(uint32_t idleFrames) noexcept;
+
+        // Creates unused pages until the allocator owns at least pageCount pages
+        void Preallocate(size_t pageCount);
+
+        // Largest number of pages in use at any of the recent calls to FenceCommittedPages
+        size_t PeakPageCount() const noexcept;
+
         // Statistics
         size_t CommittedPageCount() const noexcept { return m_numPending; }
         size_t TotalPageCount() const noexcept { return m_totalPages; }
         size_t CommittedMemoryUsage() const noexcept { return m_numPending * m_increment; }
         size_t TotalMemoryUsage() const noexcept { return m_totalPages * m_increment; }
+        size_t InUseMemoryUsage() const noexcept;
+        size_t RequestedMemoryUsage() const noexcept;
         size_t PageSize() const noexcept { return m_increment; }
 
     #if defined(_DEBUG) || defined(PROFILE)
@@ -133,15 +196,28 @@ namespace DirectX
     #endif
 
     private:
-        LinearAllocatorPage*                    m_pendingPages; // Pages in use by the GPU
+        // Pages in use by the GPU, grouped by the fence value signaled when they were submitted
+        struct PendingBucket
+        {
+            uint64_t                            fenceValue;
+            LinearAllocatorPage*                head;
+            LinearAllocatorPage*                tail;
+            size_t                              pageCount;
+        };
+
+        std::deque<PendingBucket>               m_pendingBuckets;
         LinearAllocatorPage*                    m_usedPages;    // Pages to be submitted to the GPU
         LinearAllocatorPage*                    m_unusedPages;  // Pages not being used right now
         size_t                                  m_increment;
+        size_t                                  m_heapSize;
         size_t                                  m_numPending;
         size_t                                  m_totalPages;
         uint64_t                                m_fenceCount;
+        uint64_t                                m_frameCount;
+        std::array<size_t, 120>                 m_usageHistory; // Pages in use at each of the recent frames
         Microsoft::WRL::ComPtr<ID3D12Device>    m_device;
         Microsoft::WRL::ComPtr<ID3D12Fence>     m_fence;
+        std::vector<std::shared_ptr<LinearAllocatorHeap>> m_heaps;
 
         LinearAllocatorPage* GetPageForAlloc(size_t sizeBytes, size_t alignment);
         LinearAllocatorPage* GetCleanPageForAlloc();
@@ -152,8 +228,8 @@ namespace DirectX
 
         void UnlinkPage(LinearAllocatorPage* page) noexcept;
         void LinkPage(LinearAllocatorPage* page, LinearAllocatorPage*& list) noexcept;
-        void LinkPageChain(LinearAllocatorPage* page, LinearAllocatorPage*& list) noexcept;
-        void ReleasePage(LinearAllocatorPage* page) noexcept;
+        void ResetPage(LinearAllocatorPage* page) noexcept;
+        void ReleaseEmptyHeaps() noexcept;
         void FreePages(LinearAllocatorPage* list) noexcept;
 
     #if defined(_DEBUG) || defined(PROFILE)
@@ -165,4 +241,61 @@ namespace DirectX
         void SetPageDebugName(LinearAllocatorPage* list) noexcept;
     #endif
     };
+    //----------------------------------------------------------------------------------
+    // A ring buffer allocator. A single persistently mapped upload resource is split into
+    // fixed-size chunks which are handed out in ring order, and all of the chunks used
+    // since the last call to FenceCommittedChunks share one fence value.
+    //
+    // Chunks are LinearAllocatorPage objects so that GraphicsResource handles keep them
+    // alive in the same way as pages. A chunk that is still referenced is skipped over
+    // when the ring wraps around. If the next chunk in ring order is still in use by the
+    // GPU, the producer has caught up with the consumer and ReserveChunk fails rather than
+    // waiting for the fence.
+    //
+    // This class is NOT thread safe.
+    class RingAllocator
+    {
+    public:
+        // ringSize is rounded up to a multiple of chunkSize.
+        RingAllocator(
+            _In_ ID3D12Device* pDevice,
+            _In_ size_t chunkSize,
+            _In_ size_t ringSize) noexcept(false);
+
+        RingAllocator(RingAllocator&&) = delete;
+        RingAllocator& operator= (RingAllocator&&) = delete;
+
+        RingAllocator(RingAllocator const&) = delete;
+        RingAllocator& operator=(RingAllocator const&) = delete;
+
+        ~RingAllocator();
+
+        // Returns the next free chunk for the exclusive use of a single thread, or nullptr if
+        // every chunk has already been used since the last fence or the next one is still in
+        // use by the GPU. The caller owns an additional reference which must be released
+        // before the chunk can be fenced.
+        LinearAllocatorPage* ReserveChunk();
+
+        // Call this after you submit your work to the driver.
+        void FenceCommittedChunks(_In_ ID3D12CommandQueue* commandQueue);
+
+        // Statistics
+        size_t CommittedMemoryUsage() const noexcept;
+        size_t TotalMemoryUsage() const noexcept { return m_chunks.size() * m_chunkSize; }
+        size_t ChunkCount() const noexcept { return m_chunks.size(); }
+        size_t ChunkSize() const noexcept { return m_chunkSize; }
+        size_t StallCount() const noexcept { return m_stalls; }
+
+    private:
+        std::vector<LinearAllocatorPage*>       m_chunks;
+        std::vector<LinearAllocatorPage*>       m_activeChunks; // Chunks used since they were last fenced
+        size_t                                  m_chunkSize;
+        size_t                                  m_head;
+        size_t                                  m_stalls;
+        uint64_t                                m_fenceCount;
+        Microsoft::WRL::ComPtr<ID3D12Fence>     m_fence;
+        ScopedHandle                            m_event;
+
+        void WaitForFence(uint64_t fenceValue);
+    };
 }
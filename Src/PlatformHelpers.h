@@ -96,5 +96,9 @@ namespace DirectX
 
     using ScopedHandle = std::unique_ptr<void, handle_closer>;
 
+    struct threadpool_work_closer { void operator()(PTP_WORK work) noexcept { if (work) { WaitForThreadpoolWorkCallbacks(work, TRUE); CloseThreadpoolWork(work); } } };
+
+    using ScopedThreadpoolWork = std::unique_ptr<TP_WORK, threadpool_work_closer>;
+
     inline HANDLE safe_handle(HANDLE h) noexcept { return (h == INVALID_HANDLE_VALUE) ? nullptr : h; }
 }
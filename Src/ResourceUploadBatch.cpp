@@ -14,6 +14,10 @@
 #include "LoaderHelpers.h"
 #include "PlatformHelpers.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <unordered_map>
+
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
 
@@ -26,14 +30,57 @@ namespace
 {
 #ifdef _GAMING_XBOX_SCARLETT
 #include "XboxGamingScarlettGenerateMips_main.inc"
+#include "XboxGamingScarlettGenerateMips_mainMulti.inc"
 #elif defined(_GAMING_XBOX)
 #include "XboxGamingXboxOneGenerateMips_main.inc"
+#include "XboxGamingXboxOneGenerateMips_mainMulti.inc"
 #elif defined(_XBOX_ONE) && defined(_TITLE)
 #include "XboxOneGenerateMips_main.inc"
+#include "XboxOneGenerateMips_mainMulti.inc"
 #else
 #include "GenerateMips_main.inc"
+#include "GenerateMips_mainMulti.inc"
 #endif
 
+    constexpr UINT64 c_StagingBufferSize = 64 * 1024 * 1024; // batched uploads are packed into buffers of up to this size
+
+    // 64-bit FNV-1a, used to key the upload cache
+    constexpr uint64_t c_HashOffsetBasis = 14695981039346656037ULL;
+    constexpr uint64_t c_HashPrime = 1099511628211ULL;
+
+    uint64_t HashBytes(uint64_t hash, _In_reads_bytes_(size) const void* data, size_t size) noexcept
+    {
+        auto ptr = static_cast<const uint8_t*>(data);
+        for (size_t j = 0; j < size; ++j)
+        {
+            hash ^= ptr[j];
+            hash *= c_HashPrime;
+        }
+        return hash;
+    }
+
+    template<typename T>
+    uint64_t HashValue(uint64_t hash, T value) noexcept
+    {
+        return HashBytes(hash, &value, sizeof(T));
+    }
+
+    // D3D12_RESOURCE_DESC has padding, so it is compared member by member
+    bool IsSameDesc(const D3D12_RESOURCE_DESC& a, const D3D12_RESOURCE_DESC& b) noexcept
+    {
+        return a.Dimension == b.Dimension
+            && a.Alignment == b.Alignment
+            && a.Width == b.Width
+            && a.Height == b.Height
+            && a.DepthOrArraySize == b.DepthOrArraySize
+            && a.MipLevels == b.MipLevels
+            && a.Format == b.Format
+            && a.SampleDesc.Count == b.SampleDesc.Count
+            && a.SampleDesc.Quality == b.SampleDesc.Quality
+            && a.Layout == b.Layout
+            && a.Flags == b.Flags;
+    }
+
     bool FormatIsUAVCompatible(_In_ ID3D12Device* device, bool typedUAVLoadAdditionalFormats, DXGI_FORMAT format) noexcept
     {
         switch (format)
@@ -214,20 +261,24 @@ namespace
         {
             XMFLOAT2 InvOutTexelSize;
             uint32_t SrcMipIndex;
+            uint32_t NumMipLevels;
         };
     #pragma pack(pop)
 
         static constexpr uint32_t Num32BitConstants = static_cast<uint32_t>(sizeof(ConstantData) / sizeof(uint32_t));
         static constexpr uint32_t ThreadGroupSize = 8;
+        static constexpr uint32_t MaxMipsPerDispatch = 4;
 
         ComPtr<ID3D12RootSignature> rootSignature;
         ComPtr<ID3D12PipelineState> generateMipsPSO;
+        ComPtr<ID3D12PipelineState> generateMipsMultiPSO;
 
         GenerateMipsResources(
             _In_ ID3D12Device* device)
         {
             rootSignature = CreateGenMipsRootSignature(device);
             generateMipsPSO = CreateGenMipsPipelineState(device, rootSignature.Get(), GenerateMips_main, sizeof(GenerateMips_main));
+            generateMipsMultiPSO = CreateGenMipsPipelineState(device, rootSignature.Get(), GenerateMips_mainMulti, sizeof(GenerateMips_mainMulti));
         }
 
         GenerateMipsResources(const GenerateMipsResources&) = delete;
@@ -259,7 +310,7 @@ namespace
                 D3D12_TEXTURE_ADDRESS_MODE_CLAMP);
 
             const CD3DX12_DESCRIPTOR_RANGE sourceDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
-            const CD3DX12_DESCRIPTOR_RANGE targetDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0);
+            const CD3DX12_DESCRIPTOR_RANGE targetDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, MaxMipsPerDispatch, 0);
 
             CD3DX12_ROOT_PARAMETER rootParameters[RootParameterIndex::RootParameterCount] = {};
             rootParameters[RootParameterIndex::Constants].InitAsConstants(Num32BitConstants, 0);
@@ -296,6 +347,99 @@ namespace
             return pso;
         }
     };
+
+    //----------------------------------------------------------------------------------
+    // Staging memory submitted by a ResourceUploadBatch which the GPU has not finished with
+    struct InFlightStaging
+    {
+        std::mutex              mutex;
+        std::condition_variable released;
+        size_t                  bytes;
+
+        InFlightStaging() noexcept : bytes(0) {}
+
+        // Blocks until the new submission fits in the budget, or nothing else is in flight
+        void Acquire(size_t size, size_t budget)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            if (budget > 0)
+            {
+                released.wait(lock, [&]() { return bytes == 0 || (bytes + size) <= budget; });
+            }
+
+            bytes += size;
+        }
+
+        void Release(size_t size) noexcept
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                assert(bytes >= size);
+                bytes -= size;
+            }
+
+            released.notify_all();
+        }
+    };
+
+    // Microseconds elapsed since start
+    uint64_t ElapsedMicroseconds(std::chrono::steady_clock::time_point start) noexcept
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+
+    //----------------------------------------------------------------------------------
+    // Everything kept alive until the GPU completes a submitted batch
+    struct UploadBatch
+    {
+        std::vector<ComPtr<ID3D12DeviceChild>>  TrackedObjects;
+        std::vector<SharedGraphicsResource>     TrackedMemoryResources;
+        ComPtr<ID3D12GraphicsCommandList>       CommandList;
+        ComPtr<ID3D12Fence>                     Fence;
+        ScopedHandle                            GpuCompleteEvent;
+        std::promise<void>                      Completed;
+        std::shared_ptr<InFlightStaging>        InFlight;
+        size_t                                  StagingBytes;
+        std::chrono::steady_clock::time_point   SubmitTime;
+        std::shared_ptr<std::atomic<uint64_t>>  GpuLatency;  // Set when the GPU completes, if not null
+
+        UploadBatch() noexcept : StagingBytes(0) {}
+    };
+
+    //----------------------------------------------------------------------------------
+    // Thread pool callback for a submitted batch. Each batch has a wait of its own, so batches
+    // complete in whatever order the GPU finishes them, across all queues.
+    void CALLBACK OnUploadBatchCompleted(PTP_CALLBACK_INSTANCE, PVOID context, PTP_WAIT wait, TP_WAIT_RESULT waitResult) noexcept
+    {
+        std::unique_ptr<UploadBatch> batch(static_cast<UploadBatch*>(context));
+
+        if (batch->GpuLatency)
+        {
+            batch->GpuLatency->store(ElapsedMicroseconds(batch->SubmitTime));
+        }
+
+        // The wait object is freed once this callback returns
+        CloseThreadpoolWait(wait);
+
+        // Release the tracked resources before signaling the caller
+        auto completed = std::move(batch->Completed);
+        if (batch->InFlight)
+        {
+            batch->InFlight->Release(batch->StagingBytes);
+        }
+        batch.reset();
+
+        if (waitResult != WAIT_OBJECT_0)
+        {
+            completed.set_exception(std::make_exception_ptr(std::runtime_error("SetThreadpoolWait")));
+        }
+        else
+        {
+            completed.set_value();
+        }
+    }
 } // anonymous namespace
 
 class ResourceUploadBatch::Impl
@@ -308,6 +452,12 @@ public:
         , mInBeginEndBlock(false)
         , mTypedUAVLoadAdditionalFormats(false)
         , mStandardSwizzle64KBSupported(false)
+        , mInFlight(std::make_shared<InFlightStaging>())
+        , mInFlightBudget(0)
+        , mStagingBytes(0)
+        , mStagingBudget(0)
+        , mUploadCacheEnabled(false)
+        , mStats{}
     {
         if (!device)
             throw std::invalid_argument("Direct3D device is null");
@@ -347,18 +497,30 @@ public:
             throw std::invalid_argument("commandType parameter is invalid");
         }
 
-        ThrowIfFailed(mDevice->CreateCommandAllocator(commandType, IID_GRAPHICS_PPV_ARGS(mCmdAlloc.ReleaseAndGetAddressOf())));
-
-        SetDebugObjectName(mCmdAlloc.Get(), L"ResourceUploadBatch");
+        CreateCommandList(commandType);
 
-        ThrowIfFailed(mDevice->CreateCommandList(1, commandType, mCmdAlloc.Get(), nullptr, IID_GRAPHICS_PPV_ARGS(mList.ReleaseAndGetAddressOf())));
+        mPendingTransitions.clear();
+        mPendingTransitionIndex.clear();
 
-        SetDebugObjectName(mList.Get(), L"ResourceUploadBatch");
+        TrimUploadCache();
 
+        mStats = {};
+        mBeginTime = std::chrono::steady_clock::now();
+        mGpuLatency.reset();
         mCommandType = commandType;
         mInBeginEndBlock = true;
     }
 
+    // Splits the batch into multiple submissions when its staging memory would exceed the budget.
+    void SetStagingBudget(size_t bytes, _In_opt_ ID3D12CommandQueue* commandQueue)
+    {
+        if (bytes > 0 && !commandQueue)
+            throw std::invalid_argument("Staging budget requires a command queue");
+
+        mStagingBudget = bytes;
+        mStagingQueue = commandQueue;
+    }
+
     // Asynchronously uploads a resource. The memory in subRes is copied.
     // The resource must be in the COPY_DEST or COMMON state.
     void Upload(
@@ -373,28 +535,24 @@ public:
         if (!resource || !subRes || !numSubresources)
             throw std::invalid_argument("Resource/subresource are null");
 
-        const UINT64 uploadSize = GetRequiredIntermediateSize(
-            resource,
-            subresourceIndexStart,
-            numSubresources);
+        ReserveFootprints(numSubresources);
 
-        const CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_UPLOAD);
-        const auto resDesc = CD3DX12_RESOURCE_DESC::Buffer(uploadSize);
+        UINT64 copyableBytes = 0;
+        const UINT64 uploadSize = GetFootprints(resource, subresourceIndexStart, numSubresources, 0, copyableBytes);
 
-        // Create a temporary buffer
-        ComPtr<ID3D12Resource> scratchResource = nullptr;
-        ThrowIfFailed(mDevice->CreateCommittedResource(
-            &heapProps,
-            D3D12_HEAP_FLAG_NONE,
-            &resDesc,
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr, // D3D12_CLEAR_VALUE* pOptimizedClearValue
-            IID_GRAPHICS_PPV_ARGS(scratchResource.GetAddressOf())));
+        ReserveStaging(uploadSize);
+        FlushTransitions(resource);
 
-        SetDebugObjectName(scratchResource.Get(), L"ResourceUploadBatch Temporary");
+        // Create a temporary buffer
+        auto scratchResource = CreateScratchResource(uploadSize);
+        mStagingBytes += static_cast<size_t>(uploadSize);
+        mStats.stagingBytes += static_cast<size_t>(uploadSize);
+        mStats.bytesUploaded += static_cast<size_t>(copyableBytes);
+        mStats.copies += numSubresources;
 
         // Submit resource copy to command list
-        UpdateSubresources(mList.Get(), resource, scratchResource.Get(), 0, subresourceIndexStart, numSubresources,
+        UpdateSubresources(mList.Get(), resource, scratchResource.Get(), subresourceIndexStart, numSubresources, uploadSize,
+            mLayouts.data(), mNumRows.data(), mRowSizes.data(),
         #if defined(_XBOX_ONE) && defined(_TITLE)
                     // Workaround for header constness issue
             const_cast<D3D12_SUBRESOURCE_DATA*>(subRes)
@@ -417,92 +575,328 @@ public:
         if (!resource)
             throw std::invalid_argument("Resource is null");
 
+        ReserveStaging(buffer.Size());
+        FlushTransitions(resource);
+
         // Submit resource copy to command list
         mList->CopyBufferRegion(resource, 0, buffer.Resource(), buffer.ResourceOffset(), buffer.Size());
 
         // Remember this upload resource for delayed release
         mTrackedMemoryResources.push_back(buffer);
+        mStagingBytes += buffer.Size();
+        mStats.stagingBytes += buffer.Size();
+        mStats.bytesUploaded += buffer.Size();
+        ++mStats.copies;
     }
 
-    // Asynchronously generate mips from a resource.
-    // Resource must be in the PIXEL_SHADER_RESOURCE state
-    void GenerateMips(_In_ ID3D12Resource* resource)
+    void Upload(
+        _In_reads_(count) const ResourceUploadDesc* uploads,
+        size_t count)
     {
         if (!mInBeginEndBlock)
-            throw std::logic_error("Can't call GenerateMips on a closed ResourceUploadBatch.");
+            throw std::logic_error("Can't call Upload on a closed ResourceUploadBatch.");
 
-        if (!resource)
-            throw std::invalid_argument("GenerateMips resource is null");
+        if (!uploads && count > 0)
+            throw std::invalid_argument("Upload list is null");
 
-        if (mCommandType == D3D12_COMMAND_LIST_TYPE_COPY)
+        struct Placement
         {
-            DebugTrace("ERROR: GenerateMips cannot operate on a copy queue\n");
-            throw std::runtime_error("GenerateMips cannot operate on a copy queue");
-        }
-
-    #if defined(_MSC_VER) || !defined(_WIN32)
-        const auto desc = resource->GetDesc();
-    #else
-        D3D12_RESOURCE_DESC tmpDesc;
-        const auto& desc = *resource->GetDesc(&tmpDesc);
-    #endif
+            size_t firstLayout;
+            UINT64 size;
+            UINT64 copyableBytes;
+            UINT64 offset;
+        };
 
-        if (desc.MipLevels == 1)
-        {
-            // Nothing to do
-            return;
-        }
-        if (desc.MipLevels == 0)
+        // Compute the footprints of every upload once, relative to the start of its placement
+        std::vector<Placement> placements(count);
+        size_t layoutCount = 0;
+        for (size_t j = 0; j < count; ++j)
         {
-            throw std::runtime_error("GenerateMips: texture has no mips");
+            const auto& upload = uploads[j];
+            if (!upload.resource || !upload.subRes || !upload.numSubresources)
+                throw std::invalid_argument("Resource/subresource are null");
+
+            placements[j].firstLayout = layoutCount;
+            layoutCount += upload.numSubresources;
         }
-        if (desc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D)
+
+        ReserveFootprints(layoutCount);
+
+        for (size_t j = 0; j < count; ++j)
         {
-            throw std::runtime_error("GenerateMips only supports Texture2D resources");
+            const auto& upload = uploads[j];
+            auto& placement = placements[j];
+            placement.size = GetFootprints(upload.resource, upload.subresourceIndexStart, upload.numSubresources,
+                placement.firstLayout, placement.copyableBytes);
         }
-        if (desc.DepthOrArraySize != 1)
+
+        // Place each upload in a staging buffer at texture placement alignment
+        size_t first = 0;
+        while (first < count)
         {
-            throw std::runtime_error("GenerateMips only supports 2D textures of array size 1");
+            UINT64 bufferSize = 0;
+            size_t last = first;
+            for (; last < count; ++last)
+            {
+                const UINT64 offset = AlignUp(bufferSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+                const UINT64 end = offset + placements[last].size;
+
+                // An upload larger than the staging size gets a buffer of its own
+                if (last > first && (end > c_StagingBufferSize || (mStagingBudget > 0 && end > mStagingBudget)))
+                    break;
+
+                placements[last].offset = offset;
+                bufferSize = end;
+            }
+
+            ReserveStaging(bufferSize);
+
+            auto scratchResource = CreateScratchResource(bufferSize);
+            mStagingBytes += static_cast<size_t>(bufferSize);
+            mStats.stagingBytes += static_cast<size_t>(bufferSize);
+
+            // Submit resource copies to command list
+            for (size_t j = first; j < last; ++j)
+            {
+                const auto& upload = uploads[j];
+                const auto& placement = placements[j];
+                FlushTransitions(upload.resource);
+
+                auto layouts = &mLayouts[placement.firstLayout];
+                for (uint32_t i = 0; i < upload.numSubresources; ++i)
+                {
+                    layouts[i].Offset += placement.offset;
+                }
+
+                UpdateSubresources(mList.Get(), upload.resource, scratchResource.Get(),
+                    upload.subresourceIndexStart, upload.numSubresources, placement.size,
+                    layouts, &mNumRows[placement.firstLayout], &mRowSizes[placement.firstLayout],
+                #if defined(_XBOX_ONE) && defined(_TITLE)
+                            // Workaround for header constness issue
+                    const_cast<D3D12_SUBRESOURCE_DATA*>(upload.subRes)
+                #else
+                    upload.subRes
+                #endif
+                );
+
+                mStats.bytesUploaded += static_cast<size_t>(placement.copyableBytes);
+                mStats.copies += upload.numSubresources;
+            }
+
+            // Remember this upload object for delayed release
+            mTrackedObjects.push_back(scratchResource);
+
+            first = last;
         }
+    }
+
+    // Creates and uploads a resource, or returns the cached resource with the same contents.
+    bool UploadCached(
+        const D3D12_RESOURCE_DESC& desc,
+        _In_reads_(numSubresources) const D3D12_SUBRESOURCE_DATA* subRes,
+        uint32_t numSubresources,
+        D3D12_RESOURCE_STATES afterState,
+        _COM_Outptr_ ID3D12Resource** pResource)
+    {
+        if (!pResource)
+            throw std::invalid_argument("Resource is null");
+
+        *pResource = nullptr;
+
+        if (!mInBeginEndBlock)
+            throw std::logic_error("Can't call Upload on a closed ResourceUploadBatch.");
+
+        if (!subRes || !numSubresources)
+            throw std::invalid_argument("Subresource data is null");
 
-        const bool uavCompat = FormatIsUAVCompatible(mDevice.Get(), mTypedUAVLoadAdditionalFormats, desc.Format);
+        // Resources the GPU can write to are never shared, as a write through one caller's
+        // reference would change the contents every other caller sees.
+        ENUM_FLAGS_CONSTEXPR D3D12_RESOURCE_FLAGS writableFlags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS
+            | D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET
+            | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL
+            | D3D12_RESOURCE_FLAG_ALLOW_SIMULTANEOUS_ACCESS;
 
-        if (!uavCompat && !FormatIsSRGB(desc.Format) && !FormatIsBGR(desc.Format))
+        const bool cached = mUploadCacheEnabled && (desc.Flags & writableFlags) == 0;
+
+        uint64_t hash = 0;
+        if (cached)
         {
-            throw std::runtime_error("GenerateMips doesn't support this texture format on this device");
+            hash = PackUpload(desc, subRes, numSubresources, afterState);
+
+            // A matching hash only finds the candidates, the contents are compared in full
+            const auto range = mUploadCache.equal_range(hash);
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                const auto& entry = it->second;
+                if (IsSameDesc(entry.desc, desc)
+                    && entry.afterState == afterState
+                    && entry.numSubresources == numSubresources
+                    && entry.contents == mCacheContents)
+                {
+                    entry.resource.CopyTo(pResource);
+                    ++mStats.uploadCacheHits;
+                    return false;
+                }
+            }
         }
 
-        // Ensure that we have valid generate mips data
-        if (mGenMipsResources == nullptr)
+        const CD3DX12_HEAP_PROPERTIES heapProperties(D3D12_HEAP_TYPE_DEFAULT);
+
+        ComPtr<ID3D12Resource> res;
+        ThrowIfFailed(mDevice->CreateCommittedResource(
+            &heapProperties,
+            D3D12_HEAP_FLAG_NONE,
+            &desc,
+            c_initialCopyTargetState,
+            nullptr,
+            IID_GRAPHICS_PPV_ARGS(res.GetAddressOf())));
+
+        Upload(res.Get(), 0, subRes, numSubresources);
+
+        Transition(res.Get(), D3D12_RESOURCE_STATE_COPY_DEST, afterState);
+
+        if (cached)
         {
-            mGenMipsResources = std::make_unique<GenerateMipsResources>(mDevice.Get());
+            mUploadCache.emplace(hash, UploadCacheEntry{ res, desc, afterState, numSubresources, std::move(mCacheContents) });
         }
 
-        // If the texture's format doesn't support UAVs we'll have to copy it to a texture that does first.
-        // This is true of BGRA or sRGB textures, for example.
-        if (uavCompat)
+        *pResource = res.Detach();
+        return true;
+    }
+
+    bool IsUploadCacheEnabled() const noexcept
+    {
+        return mUploadCacheEnabled;
+    }
+
+    void SetUploadCacheEnabled(bool enable)
+    {
+        mUploadCacheEnabled = enable;
+        if (!enable)
         {
-            GenerateMips_UnorderedAccessPath(resource);
+            mUploadCache.clear();
+            mCacheContents = {};
         }
-        else if (!mTypedUAVLoadAdditionalFormats)
+    }
+
+    // Asynchronously generate mips from a resource.
+    // Resource must be in the PIXEL_SHADER_RESOURCE state
+    void GenerateMips(_In_ ID3D12Resource* resource)
+    {
+        if (!resource)
+            throw std::invalid_argument("GenerateMips resource is null");
+
+        GenerateMips(&resource, 1);
+    }
+
+    // UAV compatible resources are processed together, one mip level at a time
+    void GenerateMips(_In_reads_(count) ID3D12Resource* const* resources, size_t count)
+    {
+        if (!mInBeginEndBlock)
+            throw std::logic_error("Can't call GenerateMips on a closed ResourceUploadBatch.");
+
+        if (!resources && count > 0)
+            throw std::invalid_argument("GenerateMips resource list is null");
+
+        if (mCommandType == D3D12_COMMAND_LIST_TYPE_COPY)
         {
-            throw std::runtime_error("GenerateMips needs TypedUAVLoadAdditionalFormats device support for sRGB/BGR");
+            DebugTrace("ERROR: GenerateMips cannot operate on a copy queue\n");
+            throw std::runtime_error("GenerateMips cannot operate on a copy queue");
         }
-        else if (FormatIsBGR(desc.Format))
+
+        FlushTransitions();
+
+        std::vector<ID3D12Resource*> uavResources;
+        uavResources.reserve(count);
+
+        for (size_t j = 0; j < count; ++j)
         {
-        #if !defined(_GAMING_XBOX) && !(defined(_XBOX_ONE) && defined(_TITLE))
-            if (!mStandardSwizzle64KBSupported)
+            auto resource = resources[j];
+            if (!resource)
+                throw std::invalid_argument("GenerateMips resource is null");
+
+        #if defined(_MSC_VER) || !defined(_WIN32)
+            const auto desc = resource->GetDesc();
+        #else
+            D3D12_RESOURCE_DESC tmpDesc;
+            const auto& desc = *resource->GetDesc(&tmpDesc);
+        #endif
+
+            if (desc.MipLevels == 1)
             {
-                throw std::runtime_error("GenerateMips needs StandardSwizzle64KBSupported device support for BGR");
+                // Nothing to do
+                continue;
             }
-        #endif
+            if (desc.MipLevels == 0)
+            {
+                throw std::runtime_error("GenerateMips: texture has no mips");
+            }
+            if (desc.Dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D)
+            {
+                throw std::runtime_error("GenerateMips only supports Texture2D resources");
+            }
+
+            const bool uavCompat = FormatIsUAVCompatible(mDevice.Get(), mTypedUAVLoadAdditionalFormats, desc.Format);
+
+            if (!uavCompat && !FormatIsSRGB(desc.Format) && !FormatIsBGR(desc.Format))
+            {
+                throw std::runtime_error("GenerateMips doesn't support this texture format on this device");
+            }
+
+            // Ensure that we have valid generate mips data
+            if (mGenMipsResources == nullptr)
+            {
+                mGenMipsResources = std::make_unique<GenerateMipsResources>(mDevice.Get());
+            }
+
+            // If the texture's format doesn't support UAVs we'll have to copy it to a texture that does first.
+            // This is true of BGRA or sRGB textures, for example.
+            if (uavCompat)
+            {
+                uavResources.push_back(resource);
+                continue;
+            }
+
+            if (desc.DepthOrArraySize != 1)
+            {
+                throw std::runtime_error("GenerateMips only supports sRGB/BGR 2D textures of array size 1");
+            }
+
+            if (!mTypedUAVLoadAdditionalFormats)
+            {
+                throw std::runtime_error("GenerateMips needs TypedUAVLoadAdditionalFormats device support for sRGB/BGR");
+            }
+            else if (FormatIsBGR(desc.Format))
+            {
+            #if !defined(_GAMING_XBOX) && !(defined(_XBOX_ONE) && defined(_TITLE))
+                if (!mStandardSwizzle64KBSupported)
+                {
+                    throw std::runtime_error("GenerateMips needs StandardSwizzle64KBSupported device support for BGR");
+                }
+            #endif
+
+                GenerateMips_TexturePathBGR(resource);
+            }
+            else
+            {
+                GenerateMips_TexturePath(resource);
+            }
+        }
 
-            GenerateMips_TexturePathBGR(resource);
+        if (!uavResources.empty())
+        {
+            GenerateMips_UnorderedAccessPath(uavResources.data(), uavResources.size());
         }
-        else
+    }
+
+    ResourceUploadStatistics GetStatistics() const noexcept
+    {
+        auto stats = mStats;
+        if (mGpuLatency)
         {
-            GenerateMips_TexturePath(resource);
+            stats.gpuLatency = mGpuLatency->load();
         }
+        return stats;
     }
 
     // Transition a resource once you're done with it
@@ -548,7 +942,23 @@ public:
             }
         }
 
-        TransitionResource(mList.Get(), resource, stateBefore, stateAfter);
+        if (stateBefore == stateAfter)
+            return;
+
+        // Fold into a pending transition of the same resource, if it continues from it
+        auto it = mPendingTransitionIndex.find(resource);
+        if (it != mPendingTransitionIndex.end())
+        {
+            auto& pending = mPendingTransitions[it->second].Transition;
+            if (pending.StateAfter == stateBefore)
+            {
+                pending.StateAfter = stateAfter;
+                return;
+            }
+        }
+
+        mPendingTransitionIndex[resource] = mPendingTransitions.size();
+        mPendingTransitions.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, stateBefore, stateAfter));
     }
 
     // Submits all the uploads to the driver.
@@ -563,57 +973,16 @@ public:
         if (!commandQueue)
             throw std::invalid_argument("Direct3D queue is null");
 
-        ThrowIfFailed(mList->Close());
-
-        // Submit the job to the GPU
-        commandQueue->ExecuteCommandLists(1, CommandListCast(mList.GetAddressOf()));
-
-        // Set an event so we get notified when the GPU has completed all its work
-        ComPtr<ID3D12Fence> fence;
-        ThrowIfFailed(mDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_GRAPHICS_PPV_ARGS(fence.GetAddressOf())));
-
-        SetDebugObjectName(fence.Get(), L"ResourceUploadBatch");
-
-        HANDLE gpuCompletedEvent = CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE);
-        if (!gpuCompletedEvent)
-            throw std::system_error(std::error_code(static_cast<int>(GetLastError()), std::system_category()), "CreateEventEx");
-
-        ThrowIfFailed(commandQueue->Signal(fence.Get(), 1ULL));
-        ThrowIfFailed(fence->SetEventOnCompletion(1ULL, gpuCompletedEvent));
-
-        // Create a packet of data that'll be passed to our waiting upload thread
-        auto uploadBatch = new UploadBatch();
-        uploadBatch->CommandList = mList;
-        uploadBatch->Fence = fence;
-        uploadBatch->GpuCompleteEvent.reset(gpuCompletedEvent);
-        std::swap(mTrackedObjects, uploadBatch->TrackedObjects);
-        std::swap(mTrackedMemoryResources, uploadBatch->TrackedMemoryResources);
+        mStats.cpuRecordTime = ElapsedMicroseconds(mBeginTime);
 
-        // Kick off a thread that waits for the upload to complete on the GPU timeline.
-        // Let the thread run autonomously, but provide a future the user can wait on.
-        std::future<void> future = std::async(std::launch::async, [uploadBatch]()
-            {
-                // Wait on the GPU-complete notification
-                const DWORD wr = WaitForSingleObject(uploadBatch->GpuCompleteEvent.get(), INFINITE);
-                if (wr != WAIT_OBJECT_0)
-                {
-                    if (wr == WAIT_FAILED)
-                    {
-                        throw std::system_error(std::error_code(static_cast<int>(GetLastError()), std::system_category()), "WaitForSingleObject");
-                    }
-                    else
-                    {
-                        throw std::runtime_error("WaitForSingleObject");
-                    }
-                }
+        // The queue runs submissions in order, so the latency of the last one covers the whole batch.
+        // It is stored by the batch's own completion callback, so it never includes time spent
+        // waiting on other batches.
+        mGpuLatency = std::make_shared<std::atomic<uint64_t>>(0);
 
-                // Delete the batch
-                // Because the vectors contain smart-pointers, their destructors will
-                // fire and the resources will be released.
-                delete uploadBatch;
-            });
+        std::future<void> future = Submit(commandQueue, mGpuLatency);
 
-            // Reset our state
+        // Reset our state
         mCommandType = D3D12_COMMAND_LIST_TYPE_DIRECT;
         mInBeginEndBlock = false;
         mList.Reset();
@@ -626,6 +995,11 @@ public:
         return future;
     }
 
+    void SetInFlightBudget(size_t bytes) noexcept
+    {
+        mInFlightBudget = bytes;
+    }
+
     bool IsSupportedForGenerateMips(DXGI_FORMAT format) noexcept
     {
         if (mCommandType == D3D12_COMMAND_LIST_TYPE_COPY)
@@ -655,9 +1029,151 @@ public:
     }
 
 private:
-    // Resource is UAV compatible
-    void GenerateMips_UnorderedAccessPath(
-        _In_ ID3D12Resource* resource)
+    void CreateCommandList(D3D12_COMMAND_LIST_TYPE commandType)
+    {
+        ThrowIfFailed(mDevice->CreateCommandAllocator(commandType, IID_GRAPHICS_PPV_ARGS(mCmdAlloc.ReleaseAndGetAddressOf())));
+
+        SetDebugObjectName(mCmdAlloc.Get(), L"ResourceUploadBatch");
+
+        ThrowIfFailed(mDevice->CreateCommandList(1, commandType, mCmdAlloc.Get(), nullptr, IID_GRAPHICS_PPV_ARGS(mList.ReleaseAndGetAddressOf())));
+
+        SetDebugObjectName(mList.Get(), L"ResourceUploadBatch");
+    }
+
+    // Submits the work recorded so far and starts a new command list if the next upload
+    // would take the batch over the staging budget. Submissions on the same queue complete
+    // in order, so the future returned by End also covers the earlier splits.
+    void ReserveStaging(UINT64 uploadSize)
+    {
+        if (!mStagingBudget || !mStagingBytes || (mStagingBytes + uploadSize) <= mStagingBudget)
+            return;
+
+        std::ignore = Submit(mStagingQueue.Get());
+
+        CreateCommandList(mCommandType);
+    }
+
+    std::future<void> Submit(
+        _In_ ID3D12CommandQueue* commandQueue,
+        std::shared_ptr<std::atomic<uint64_t>> gpuLatency = nullptr)
+    {
+        FlushTransitions();
+
+        ThrowIfFailed(mList->Close());
+
+        // Set an event so we get notified when the GPU has completed all its work
+        ComPtr<ID3D12Fence> fence;
+        ThrowIfFailed(mDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_GRAPHICS_PPV_ARGS(fence.GetAddressOf())));
+
+        SetDebugObjectName(fence.Get(), L"ResourceUploadBatch");
+
+        HANDLE gpuCompletedEvent = CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE);
+        if (!gpuCompletedEvent)
+            throw std::system_error(std::error_code(static_cast<int>(GetLastError()), std::system_category()), "CreateEventEx");
+
+        // Create a packet of data that'll be released once the GPU is done with it
+        auto uploadBatch = std::make_unique<UploadBatch>();
+        uploadBatch->CommandList = mList;
+        uploadBatch->Fence = fence;
+        uploadBatch->GpuCompleteEvent.reset(gpuCompletedEvent);
+        uploadBatch->GpuLatency = std::move(gpuLatency);
+        std::swap(mTrackedObjects, uploadBatch->TrackedObjects);
+        std::swap(mTrackedMemoryResources, uploadBatch->TrackedMemoryResources);
+        uploadBatch->TrackedObjects.push_back(mCmdAlloc);
+
+        PTP_WAIT wait = CreateThreadpoolWait(OnUploadBatchCompleted, uploadBatch.get(), nullptr);
+        if (!wait)
+            throw std::system_error(std::error_code(static_cast<int>(GetLastError()), std::system_category()), "CreateThreadpoolWait");
+
+        // Apply back-pressure until earlier batches release enough staging memory, before the
+        // GPU is given any more work
+        mInFlight->Acquire(mStagingBytes, mInFlightBudget);
+        uploadBatch->InFlight = mInFlight;
+        uploadBatch->StagingBytes = mStagingBytes;
+        mStagingBytes = 0;
+
+        // Submit the job to the GPU
+        commandQueue->ExecuteCommandLists(1, CommandListCast(mList.GetAddressOf()));
+        uploadBatch->SubmitTime = std::chrono::steady_clock::now();
+
+        HRESULT hr = commandQueue->Signal(fence.Get(), 1ULL);
+        if (SUCCEEDED(hr))
+        {
+            hr = fence->SetEventOnCompletion(1ULL, gpuCompletedEvent);
+        }
+
+        if (FAILED(hr))
+        {
+            CloseThreadpoolWait(wait);
+            mInFlight->Release(uploadBatch->StagingBytes);
+            ThrowIfFailed(hr);
+        }
+
+        ++mStats.submissions;
+
+        // The thread pool callback takes ownership of the batch, releases it once the GPU is
+        // done with it, and completes the future the user can wait on.
+        auto future = uploadBatch->Completed.get_future();
+        SetThreadpoolWait(wait, gpuCompletedEvent, nullptr);
+        uploadBatch.release();
+
+        return future;
+    }
+
+    // Issues the pending transitions with a single ResourceBarrier call, dropping the ones
+    // that cancelled out
+    void FlushTransitions()
+    {
+        if (mPendingTransitions.empty())
+            return;
+
+        auto end = std::remove_if(mPendingTransitions.begin(), mPendingTransitions.end(),
+            [](const D3D12_RESOURCE_BARRIER& barrier) noexcept
+            {
+                return barrier.Transition.StateBefore == barrier.Transition.StateAfter;
+            });
+        mPendingTransitions.erase(end, mPendingTransitions.end());
+
+        if (!mPendingTransitions.empty())
+        {
+            mList->ResourceBarrier(static_cast<UINT>(mPendingTransitions.size()), mPendingTransitions.data());
+            mStats.transitions += mPendingTransitions.size();
+            ++mStats.transitionCalls;
+        }
+
+        mPendingTransitions.clear();
+        mPendingTransitionIndex.clear();
+    }
+
+    // Only a copy into a resource with a pending transition needs to wait for it
+    void FlushTransitions(_In_ ID3D12Resource* resource)
+    {
+        if (mPendingTransitionIndex.find(resource) != mPendingTransitionIndex.end())
+        {
+            FlushTransitions();
+        }
+    }
+
+    // Grows the footprint arrays, which are reused across uploads
+    void ReserveFootprints(size_t count)
+    {
+        if (mLayouts.size() < count)
+        {
+            mLayouts.resize(count);
+            mNumRows.resize(count);
+            mRowSizes.resize(count);
+        }
+    }
+
+    // Computes the copyable footprints of the subresources into the footprint arrays at index,
+    // returning the staging size. Adds the bytes of source data the copies read, excluding row
+    // padding, to copyableBytes.
+    UINT64 GetFootprints(
+        _In_ ID3D12Resource* resource,
+        uint32_t subresourceIndexStart,
+        uint32_t numSubresources,
+        size_t index,
+        UINT64& copyableBytes)
     {
     #if defined(_MSC_VER) || !defined(_WIN32)
         const auto desc = resource->GetDesc();
@@ -665,7 +1181,130 @@ private:
         D3D12_RESOURCE_DESC tmpDesc;
         const auto& desc = *resource->GetDesc(&tmpDesc);
     #endif
-        assert(!FormatIsBGR(desc.Format) && !FormatIsSRGB(desc.Format));
+
+        UINT64 requiredSize = 0;
+        mDevice->GetCopyableFootprints(&desc, subresourceIndexStart, numSubresources, 0,
+            &mLayouts[index], &mNumRows[index], &mRowSizes[index], &requiredSize);
+
+        for (size_t i = index; i < index + numSubresources; ++i)
+        {
+            copyableBytes += mRowSizes[i] * mNumRows[i] * mLayouts[i].Footprint.Depth;
+        }
+
+        return requiredSize;
+    }
+
+    // Packs the bytes UpdateSubresources would copy into mCacheContents, skipping row padding,
+    // and returns their hash combined with the description and state
+    uint64_t PackUpload(
+        const D3D12_RESOURCE_DESC& desc,
+        _In_reads_(numSubresources) const D3D12_SUBRESOURCE_DATA* subRes,
+        uint32_t numSubresources,
+        D3D12_RESOURCE_STATES afterState)
+    {
+        uint64_t hash = c_HashOffsetBasis;
+        hash = HashValue(hash, desc.Dimension);
+        hash = HashValue(hash, desc.Alignment);
+        hash = HashValue(hash, desc.Width);
+        hash = HashValue(hash, desc.Height);
+        hash = HashValue(hash, desc.DepthOrArraySize);
+        hash = HashValue(hash, desc.MipLevels);
+        hash = HashValue(hash, desc.Format);
+        hash = HashValue(hash, desc.SampleDesc.Count);
+        hash = HashValue(hash, desc.SampleDesc.Quality);
+        hash = HashValue(hash, desc.Layout);
+        hash = HashValue(hash, desc.Flags);
+        hash = HashValue(hash, afterState);
+
+        ReserveFootprints(numSubresources);
+
+        UINT64 requiredSize = 0;
+        mDevice->GetCopyableFootprints(&desc, 0, numSubresources, 0, mLayouts.data(), mNumRows.data(), mRowSizes.data(), &requiredSize);
+        if (requiredSize == UINT64(-1))
+            throw std::invalid_argument("Invalid resource description");
+
+        UINT64 totalBytes = 0;
+        for (uint32_t i = 0; i < numSubresources; ++i)
+        {
+            if (!subRes[i].pData)
+                throw std::invalid_argument("Subresource data is null");
+
+            totalBytes += mRowSizes[i] * mNumRows[i] * mLayouts[i].Footprint.Depth;
+        }
+
+        mCacheContents.resize(static_cast<size_t>(totalBytes));
+
+        auto dest = mCacheContents.data();
+        for (uint32_t i = 0; i < numSubresources; ++i)
+        {
+            const auto rowSize = static_cast<size_t>(mRowSizes[i]);
+            auto src = static_cast<const uint8_t*>(subRes[i].pData);
+            for (UINT z = 0; z < mLayouts[i].Footprint.Depth; ++z)
+            {
+                auto slice = src + static_cast<size_t>(subRes[i].SlicePitch) * z;
+                for (UINT y = 0; y < mNumRows[i]; ++y)
+                {
+                    memcpy(dest, slice + static_cast<size_t>(subRes[i].RowPitch) * y, rowSize);
+                    dest += rowSize;
+                }
+            }
+        }
+
+        return HashBytes(hash, mCacheContents.data(), mCacheContents.size());
+    }
+
+    // Drops the cached resources the application no longer references
+    void TrimUploadCache()
+    {
+        for (auto it = mUploadCache.begin(); it != mUploadCache.end();)
+        {
+            // Release returns the remaining count, which is one when only the cache holds it
+            auto resource = it->second.resource.Get();
+            resource->AddRef();
+            if (resource->Release() == 1)
+            {
+                it = mUploadCache.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    ComPtr<ID3D12Resource> CreateScratchResource(UINT64 uploadSize)
+    {
+        const CD3DX12_HEAP_PROPERTIES heapProps(D3D12_HEAP_TYPE_UPLOAD);
+        const auto resDesc = CD3DX12_RESOURCE_DESC::Buffer(uploadSize);
+
+        ComPtr<ID3D12Resource> scratchResource;
+        ThrowIfFailed(mDevice->CreateCommittedResource(
+            &heapProps,
+            D3D12_HEAP_FLAG_NONE,
+            &resDesc,
+            D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr, // D3D12_CLEAR_VALUE* pOptimizedClearValue
+            IID_GRAPHICS_PPV_ARGS(scratchResource.GetAddressOf())));
+
+        SetDebugObjectName(scratchResource.Get(), L"ResourceUploadBatch Temporary");
+
+        return scratchResource;
+    }
+
+    // Resource is UAV compatible
+    void GenerateMips_UnorderedAccessPath(
+        _In_reads_(count) ID3D12Resource* const* resources,
+        size_t count)
+    {
+        struct MipTarget
+        {
+            ID3D12Resource*         resource;
+            ComPtr<ID3D12Resource>  staging;
+            D3D12_RESOURCE_DESC     desc;
+            uint32_t                firstDescriptor;
+            uint32_t                nextMip;
+            uint32_t                passMips;
+        };
 
         const CD3DX12_HEAP_PROPERTIES defaultHeapProperties(D3D12_HEAP_TYPE_DEFAULT);
 
@@ -673,107 +1312,138 @@ private:
         const D3D12_RESOURCE_STATES originalState = (mCommandType == D3D12_COMMAND_LIST_TYPE_COMPUTE)
             ? D3D12_RESOURCE_STATE_COPY_DEST : D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
 
-        // Create a staging resource if we have to
-        ComPtr<ID3D12Resource> staging;
-        if ((desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS) == 0)
+        std::vector<MipTarget> targets(count);
+        std::vector<D3D12_RESOURCE_BARRIER> barriers;
+        uint32_t descriptorCount = 0;
+
+        // Create staging resources where we have to, and move everything to the shader resource state
+        for (size_t j = 0; j < count; ++j)
         {
-            D3D12_RESOURCE_DESC stagingDesc = desc;
-            stagingDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
-            stagingDesc.Format = ConvertSRVtoResourceFormat(desc.Format);
+            auto& target = targets[j];
+            target.resource = resources[j];
+        #if defined(_MSC_VER) || !defined(_WIN32)
+            target.desc = target.resource->GetDesc();
+        #else
+            std::ignore = target.resource->GetDesc(&target.desc);
+        #endif
+            assert(!FormatIsBGR(target.desc.Format) && !FormatIsSRGB(target.desc.Format));
 
-            ThrowIfFailed(mDevice->CreateCommittedResource(
-                &defaultHeapProperties,
-                D3D12_HEAP_FLAG_NONE,
-                &stagingDesc,
-                D3D12_RESOURCE_STATE_COPY_DEST,
-                nullptr,
-                IID_GRAPHICS_PPV_ARGS(staging.GetAddressOf())));
+            target.nextMip = 1;
+            target.passMips = 0;
 
-            SetDebugObjectName(staging.Get(), L"GenerateMips Staging");
+            // The SRV, a UAV per tail mip, and null UAVs padding out the last UAV table
+            target.firstDescriptor = descriptorCount;
+            descriptorCount += target.desc.MipLevels + GenerateMipsResources::MaxMipsPerDispatch - 1;
 
-            // Copy the top mip of resource to staging
-            TransitionResource(mList.Get(), resource, originalState, D3D12_RESOURCE_STATE_COPY_SOURCE);
+            if ((target.desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS) == 0)
+            {
+                D3D12_RESOURCE_DESC stagingDesc = target.desc;
+                stagingDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+                stagingDesc.Format = ConvertSRVtoResourceFormat(target.desc.Format);
+
+                ThrowIfFailed(mDevice->CreateCommittedResource(
+                    &defaultHeapProperties,
+                    D3D12_HEAP_FLAG_NONE,
+                    &stagingDesc,
+                    D3D12_RESOURCE_STATE_COPY_DEST,
+                    nullptr,
+                    IID_GRAPHICS_PPV_ARGS(target.staging.GetAddressOf())));
+
+                SetDebugObjectName(target.staging.Get(), L"GenerateMips Staging");
 
-            const CD3DX12_TEXTURE_COPY_LOCATION src(resource, 0);
-            const CD3DX12_TEXTURE_COPY_LOCATION dst(staging.Get(), 0);
-            mList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+                barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(target.resource, originalState, D3D12_RESOURCE_STATE_COPY_SOURCE));
+            }
+            else
+            {
+                // Resource is already a UAV so we can do this in-place
+                target.staging = target.resource;
 
-            TransitionResource(mList.Get(), staging.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+                barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(target.resource, originalState, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+            }
         }
-        else
+
+        FlushBarriers(barriers);
+
+        // Copy the top mip of each array slice to staging
+        for (auto& target : targets)
         {
-            // Resource is already a UAV so we can do this in-place
-            staging = resource;
+            if (target.staging.Get() == target.resource)
+                continue;
 
-            TransitionResource(mList.Get(), staging.Get(), originalState, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+            for (uint32_t slice = 0; slice < target.desc.DepthOrArraySize; ++slice)
+            {
+                const UINT subresource = D3D12CalcSubresource(0, slice, 0, target.desc.MipLevels, target.desc.DepthOrArraySize);
+                const CD3DX12_TEXTURE_COPY_LOCATION src(target.resource, subresource);
+                const CD3DX12_TEXTURE_COPY_LOCATION dst(target.staging.Get(), subresource);
+                mList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+            }
+
+            barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(target.staging.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
         }
 
-        // Create a descriptor heap that holds our resource descriptors
+        FlushBarriers(barriers);
+
+        // Create a descriptor heap that holds a SRV and the tail UAVs for every resource
         ComPtr<ID3D12DescriptorHeap> descriptorHeap;
         D3D12_DESCRIPTOR_HEAP_DESC descriptorHeapDesc = {};
         descriptorHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
         descriptorHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-        descriptorHeapDesc.NumDescriptors = desc.MipLevels;
-        mDevice->CreateDescriptorHeap(&descriptorHeapDesc, IID_GRAPHICS_PPV_ARGS(descriptorHeap.GetAddressOf()));
+        descriptorHeapDesc.NumDescriptors = descriptorCount;
+        ThrowIfFailed(mDevice->CreateDescriptorHeap(&descriptorHeapDesc, IID_GRAPHICS_PPV_ARGS(descriptorHeap.GetAddressOf())));
 
         SetDebugObjectName(descriptorHeap.Get(), L"ResourceUploadBatch");
 
         const auto descriptorSize = static_cast<int>(mDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV));
 
-        // Create the top-level SRV
     #if defined(_MSC_VER) || !defined(_WIN32)
         CD3DX12_CPU_DESCRIPTOR_HANDLE handleIt(descriptorHeap->GetCPUDescriptorHandleForHeapStart());
     #else
         CD3DX12_CPU_DESCRIPTOR_HANDLE handleIt;
         std::ignore = descriptorHeap->GetCPUDescriptorHandleForHeapStart(&handleIt);
     #endif
-        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-        srvDesc.Format = desc.Format;
-        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-        srvDesc.Texture2D.MostDetailedMip = 0;
-        srvDesc.Texture2D.MipLevels = desc.MipLevels;
 
-        mDevice->CreateShaderResourceView(staging.Get(), &srvDesc, handleIt);
-
-        // Create the UAVs for the tail
-        for (uint16_t mip = 1; mip < desc.MipLevels; ++mip)
+        for (const auto& target : targets)
         {
-            D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
-            uavDesc.Format = desc.Format;
-            uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2D;
-            uavDesc.Texture2D.MipSlice = mip;
-
+            // Create the top-level SRV, as an array view so the shader handles arrays and cubemaps
+            D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+            srvDesc.Format = target.desc.Format;
+            srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+            srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+            srvDesc.Texture2DArray.MipLevels = target.desc.MipLevels;
+            srvDesc.Texture2DArray.ArraySize = target.desc.DepthOrArraySize;
+
+            mDevice->CreateShaderResourceView(target.staging.Get(), &srvDesc, handleIt);
             handleIt.Offset(descriptorSize);
-            mDevice->CreateUnorderedAccessView(staging.Get(), nullptr, &uavDesc, handleIt);
+
+            // Create the UAVs for the tail
+            for (uint16_t mip = 1; mip < target.desc.MipLevels; ++mip)
+            {
+                D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+                uavDesc.Format = target.desc.Format;
+                uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2DARRAY;
+                uavDesc.Texture2DArray.MipSlice = mip;
+                uavDesc.Texture2DArray.ArraySize = target.desc.DepthOrArraySize;
+
+                mDevice->CreateUnorderedAccessView(target.staging.Get(), nullptr, &uavDesc, handleIt);
+                handleIt.Offset(descriptorSize);
+            }
+
+            // Every descriptor in a bound table must be valid, even those the shader does not write
+            for (uint32_t j = 1; j < GenerateMipsResources::MaxMipsPerDispatch; ++j)
+            {
+                D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+                uavDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+                uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2DARRAY;
+                uavDesc.Texture2DArray.ArraySize = 1;
+
+                mDevice->CreateUnorderedAccessView(nullptr, nullptr, &uavDesc, handleIt);
+                handleIt.Offset(descriptorSize);
+            }
         }
 
-        // Set up UAV barrier (used in loop)
-        D3D12_RESOURCE_BARRIER barrierUAV = {};
-        barrierUAV.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
-        barrierUAV.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-        barrierUAV.UAV.pResource = staging.Get();
-
-        // Barrier for transitioning the subresources to UAVs
-        D3D12_RESOURCE_BARRIER srv2uavDesc = {};
-        srv2uavDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        srv2uavDesc.Transition.pResource = staging.Get();
-        srv2uavDesc.Transition.Subresource = 0;
-        srv2uavDesc.Transition.StateBefore = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
-        srv2uavDesc.Transition.StateAfter = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
-
-        // Barrier for transitioning the subresources to SRVs
-        D3D12_RESOURCE_BARRIER uav2srvDesc = {};
-        uav2srvDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        uav2srvDesc.Transition.pResource = staging.Get();
-        uav2srvDesc.Transition.Subresource = 0;
-        uav2srvDesc.Transition.StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
-        uav2srvDesc.Transition.StateAfter = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
-
-        // based on format, select srgb or not
+        // Set up state
         ComPtr<ID3D12PipelineState> pso = mGenMipsResources->generateMipsPSO;
 
-        // Set up state
         mList->SetComputeRootSignature(mGenMipsResources->rootSignature.Get());
         mList->SetPipelineState(pso.Get());
         mList->SetDescriptorHeaps(1, descriptorHeap.GetAddressOf());
@@ -784,89 +1454,181 @@ private:
         D3D12_GPU_DESCRIPTOR_HANDLE handle;
         std::ignore = descriptorHeap->GetGPUDescriptorHandleForHeapStart(&handle);
     #endif
-        mList->SetComputeRootDescriptorTable(GenerateMipsResources::SourceTexture, handle);
 
-        // Get the descriptor handle -- uavH will increment over each loop
-        CD3DX12_GPU_DESCRIPTOR_HANDLE uavH(handle, descriptorSize); // offset by 1 descriptor
-
-        // Process each mip
-        auto mipWidth = static_cast<uint32_t>(desc.Width);
-        uint32_t mipHeight = desc.Height;
-        for (uint32_t mip = 1; mip < desc.MipLevels; ++mip)
+        // Each pass generates the next levels of every resource that still has some, with one
+        // barrier call before and after. Where the dimensions allow, the single-pass shader
+        // writes up to MaxMipsPerDispatch levels in one dispatch.
+        ID3D12PipelineState* currentPSO = pso.Get();
+        for (;;)
         {
-            mipWidth = std::max<uint32_t>(1, mipWidth >> 1);
-            mipHeight = std::max<uint32_t>(1, mipHeight >> 1);
-
-            // Transition the mip to a UAV
-            srv2uavDesc.Transition.Subresource = mip;
-            mList->ResourceBarrier(1, &srv2uavDesc);
-
-            // Bind the mip subresources
-            mList->SetComputeRootDescriptorTable(GenerateMipsResources::TargetTexture, uavH);
-
-            // Set constants
-            GenerateMipsResources::ConstantData constants;
-            constants.SrcMipIndex = mip - 1;
-            constants.InvOutTexelSize = XMFLOAT2(1 / float(mipWidth), 1 / float(mipHeight));
-            mList->SetComputeRoot32BitConstants(
-                GenerateMipsResources::Constants,
-                GenerateMipsResources::Num32BitConstants,
-                &constants,
-                0);
-
-            // Process this mip
-            mList->Dispatch(
-                (mipWidth + GenerateMipsResources::ThreadGroupSize - 1) / GenerateMipsResources::ThreadGroupSize,
-                (mipHeight + GenerateMipsResources::ThreadGroupSize - 1) / GenerateMipsResources::ThreadGroupSize,
-                1);
-
-            mList->ResourceBarrier(1, &barrierUAV);
-
-            // Transition the mip to an SRV
-            uav2srvDesc.Transition.Subresource = mip;
-            mList->ResourceBarrier(1, &uav2srvDesc);
-
-            // Offset the descriptor heap handles
-            uavH.Offset(descriptorSize);
+            bool pending = false;
+            for (auto& target : targets)
+            {
+                target.passMips = (target.nextMip < target.desc.MipLevels) ? GetMipsForPass(target.desc, target.nextMip) : 0;
+                if (!target.passMips)
+                    continue;
+
+                pending = true;
+
+                // Transition the mips of every array slice to UAVs
+                for (uint32_t mip = target.nextMip; mip < target.nextMip + target.passMips; ++mip)
+                {
+                    for (uint32_t slice = 0; slice < target.desc.DepthOrArraySize; ++slice)
+                    {
+                        barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
+                            target.staging.Get(),
+                            D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                            D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+                            D3D12CalcSubresource(mip, slice, 0, target.desc.MipLevels, target.desc.DepthOrArraySize)));
+                    }
+                }
+            }
+
+            if (!pending)
+                break;
+
+            FlushBarriers(barriers);
+
+            for (const auto& target : targets)
+            {
+                if (!target.passMips)
+                    continue;
+
+                const uint32_t mip = target.nextMip;
+
+                auto passPSO = (target.passMips > 1) ? mGenMipsResources->generateMipsMultiPSO.Get() : pso.Get();
+                if (passPSO != currentPSO)
+                {
+                    mList->SetPipelineState(passPSO);
+                    currentPSO = passPSO;
+                }
+
+                // Bind the source texture and the mip subresources
+                const CD3DX12_GPU_DESCRIPTOR_HANDLE srvH(handle, static_cast<INT>(target.firstDescriptor), static_cast<UINT>(descriptorSize));
+                const CD3DX12_GPU_DESCRIPTOR_HANDLE uavH(srvH, static_cast<INT>(mip), static_cast<UINT>(descriptorSize));
+                mList->SetComputeRootDescriptorTable(GenerateMipsResources::SourceTexture, srvH);
+                mList->SetComputeRootDescriptorTable(GenerateMipsResources::TargetTexture, uavH);
+
+                const uint32_t mipWidth = std::max<uint32_t>(1, static_cast<uint32_t>(target.desc.Width >> mip));
+                const uint32_t mipHeight = std::max<uint32_t>(1, target.desc.Height >> mip);
+
+                // Set constants
+                GenerateMipsResources::ConstantData constants;
+                constants.SrcMipIndex = mip - 1;
+                constants.InvOutTexelSize = XMFLOAT2(1 / float(mipWidth), 1 / float(mipHeight));
+                constants.NumMipLevels = target.passMips;
+                mList->SetComputeRoot32BitConstants(
+                    GenerateMipsResources::Constants,
+                    GenerateMipsResources::Num32BitConstants,
+                    &constants,
+                    0);
+
+                // Process these mips of every array slice
+                mList->Dispatch(
+                    (mipWidth + GenerateMipsResources::ThreadGroupSize - 1) / GenerateMipsResources::ThreadGroupSize,
+                    (mipHeight + GenerateMipsResources::ThreadGroupSize - 1) / GenerateMipsResources::ThreadGroupSize,
+                    target.desc.DepthOrArraySize);
+
+                ++mStats.mipDispatches;
+
+                barriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(target.staging.Get()));
+            }
+
+            // Transition the mips back to SRVs for the next pass
+            for (auto& target : targets)
+            {
+                if (!target.passMips)
+                    continue;
+
+                for (uint32_t mip = target.nextMip; mip < target.nextMip + target.passMips; ++mip)
+                {
+                    for (uint32_t slice = 0; slice < target.desc.DepthOrArraySize; ++slice)
+                    {
+                        barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(
+                            target.staging.Get(),
+                            D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+                            D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+                            D3D12CalcSubresource(mip, slice, 0, target.desc.MipLevels, target.desc.DepthOrArraySize)));
+                    }
+                }
+
+                target.nextMip += target.passMips;
+            }
+
+            FlushBarriers(barriers);
         }
 
         // If the staging resource is NOT the same as the resource, we need to copy everything back
-        if (staging.Get() != resource)
+        for (const auto& target : targets)
         {
-            // Transition the resources ready for copy
-            D3D12_RESOURCE_BARRIER barrier[2] = {};
-            barrier[0].Type = barrier[1].Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-            barrier[0].Transition.Subresource = barrier[1].Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-            barrier[0].Transition.pResource = staging.Get();
-            barrier[0].Transition.StateBefore = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
-            barrier[0].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
+            if (target.staging.Get() != target.resource)
+            {
+                barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(target.staging.Get(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE));
+                barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(target.resource, D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_COPY_DEST));
+            }
+        }
 
-            barrier[1].Transition.pResource = resource;
-            barrier[1].Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_SOURCE;
-            barrier[1].Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_DEST;
+        FlushBarriers(barriers);
 
-            mList->ResourceBarrier(2, barrier);
+        for (const auto& target : targets)
+        {
+            if (target.staging.Get() != target.resource)
+            {
+                // Copy the entire resource back
+                mList->CopyResource(target.resource, target.staging.Get());
 
-            // Copy the entire resource back
-            mList->CopyResource(resource, staging.Get());
+                barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(target.resource, D3D12_RESOURCE_STATE_COPY_DEST, originalState));
 
-            // Transition the target resource back to pixel shader resource
-            TransitionResource(mList.Get(), resource, D3D12_RESOURCE_STATE_COPY_DEST, originalState);
+                mTrackedObjects.push_back(target.staging);
+            }
+            else
+            {
+                barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(target.resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, originalState));
+            }
 
-            mTrackedObjects.push_back(staging);
-        }
-        else
-        {
-            TransitionResource(mList.Get(), staging.Get(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, originalState);
+            mTrackedObjects.push_back(target.resource);
         }
 
+        FlushBarriers(barriers);
+
         // Add our temporary objects to the deferred deletion queue
         mTrackedObjects.push_back(mGenMipsResources->rootSignature);
         mTrackedObjects.push_back(pso);
-        mTrackedObjects.push_back(resource);
+        mTrackedObjects.push_back(mGenMipsResources->generateMipsMultiPSO);
         mTrackedObjects.push_back(descriptorHeap);
     }
 
+    // The single-pass shader halves each level exactly, so every extra level it writes
+    // needs the source dimensions to be divisible by another factor of 2.
+    static uint32_t GetMipsForPass(const D3D12_RESOURCE_DESC& desc, uint32_t mip) noexcept
+    {
+        const uint64_t srcWidth = std::max<uint64_t>(1, desc.Width >> (mip - 1));
+        const uint32_t srcHeight = std::max<uint32_t>(1, desc.Height >> (mip - 1));
+
+        uint32_t levels = 1;
+        while (levels < GenerateMipsResources::MaxMipsPerDispatch
+            && (mip + levels) < desc.MipLevels
+            && (srcWidth % (uint64_t(2) << levels)) == 0
+            && (srcHeight % (2u << levels)) == 0)
+        {
+            ++levels;
+        }
+
+        return levels;
+    }
+
+    // Issues the accumulated barriers with a single call
+    void FlushBarriers(std::vector<D3D12_RESOURCE_BARRIER>& barriers)
+    {
+        if (barriers.empty())
+            return;
+
+        mList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+        ++mStats.mipBarrierCalls;
+
+        barriers.clear();
+    }
+
     // Resource is not UAV compatible
     void GenerateMips_TexturePath(
         _In_ ID3D12Resource* resource)
@@ -911,7 +1673,8 @@ private:
         TransitionResource(mList.Get(), resourceCopy.Get(), D3D12_RESOURCE_STATE_COPY_DEST, originalState);
 
         // Generate the mips
-        GenerateMips_UnorderedAccessPath(resourceCopy.Get());
+        ID3D12Resource* copy = resourceCopy.Get();
+        GenerateMips_UnorderedAccessPath(&copy, 1);
 
         // Direct copy back
         D3D12_RESOURCE_BARRIER barrier[2] = {};
@@ -1031,7 +1794,8 @@ private:
         aliasBarrier[1].Transition.StateAfter = originalState;
 
         mList->ResourceBarrier(2, aliasBarrier);
-        GenerateMips_UnorderedAccessPath(resourceCopy.Get());
+        ID3D12Resource* copy = resourceCopy.Get();
+        GenerateMips_UnorderedAccessPath(&copy, 1);
 
         // Direct copy back RGB to BGR
         aliasBarrier[0].Aliasing.pResourceBefore = resourceCopy.Get();
@@ -1058,17 +1822,6 @@ private:
         mTrackedObjects.push_back(resource);
     }
 
-    struct UploadBatch
-    {
-        std::vector<ComPtr<ID3D12DeviceChild>>  TrackedObjects;
-        std::vector<SharedGraphicsResource>     TrackedMemoryResources;
-        ComPtr<ID3D12GraphicsCommandList>       CommandList;
-        ComPtr<ID3D12Fence>                     Fence;
-        ScopedHandle                            GpuCompleteEvent;
-
-        UploadBatch() noexcept {}
-    };
-
     ComPtr<ID3D12Device>                        mDevice;
     ComPtr<ID3D12CommandAllocator>              mCmdAlloc;
     ComPtr<ID3D12GraphicsCommandList>           mList;
@@ -1077,10 +1830,40 @@ private:
     std::vector<ComPtr<ID3D12DeviceChild>>      mTrackedObjects;
     std::vector<SharedGraphicsResource>         mTrackedMemoryResources;
 
+    std::vector<D3D12_RESOURCE_BARRIER>         mPendingTransitions;
+    std::unordered_map<ID3D12Resource*, size_t> mPendingTransitionIndex;    // Latest pending transition of each resource
+
     D3D12_COMMAND_LIST_TYPE                     mCommandType;
     bool                                        mInBeginEndBlock;
     bool                                        mTypedUAVLoadAdditionalFormats;
     bool                                        mStandardSwizzle64KBSupported;
+
+    std::shared_ptr<InFlightStaging>            mInFlight;
+    size_t                                      mInFlightBudget;
+    size_t                                      mStagingBytes;
+    size_t                                      mStagingBudget;
+    ComPtr<ID3D12CommandQueue>                  mStagingQueue;
+
+    std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> mLayouts;
+    std::vector<UINT>                           mNumRows;
+    std::vector<UINT64>                         mRowSizes;
+
+    struct UploadCacheEntry
+    {
+        ComPtr<ID3D12Resource>                  resource;
+        D3D12_RESOURCE_DESC                     desc;
+        D3D12_RESOURCE_STATES                   afterState;
+        uint32_t                                numSubresources;
+        std::vector<uint8_t>                    contents;   // Source data without row padding
+    };
+
+    bool                                        mUploadCacheEnabled;
+    std::unordered_multimap<uint64_t, UploadCacheEntry> mUploadCache;
+    std::vector<uint8_t>                        mCacheContents;
+
+    ResourceUploadStatistics                    mStats;
+    std::chrono::steady_clock::time_point       mBeginTime;
+    std::shared_ptr<std::atomic<uint64_t>>      mGpuLatency;
 };
 
 
@@ -1123,6 +1906,39 @@ void ResourceUploadBatch::Upload(
 }
 
 
+_Use_decl_annotations_
+void ResourceUploadBatch::Upload(
+    const ResourceUploadDesc* uploads,
+    size_t count)
+{
+    pImpl->Upload(uploads, count);
+}
+
+
+
+_Use_decl_annotations_
+bool ResourceUploadBatch::UploadCached(
+    const D3D12_RESOURCE_DESC& desc,
+    const D3D12_SUBRESOURCE_DATA* subRes,
+    uint32_t numSubresources,
+    D3D12_RESOURCE_STATES afterState,
+    ID3D12Resource** pResource)
+{
+    return pImpl->UploadCached(desc, subRes, numSubresources, afterState, pResource);
+}
+
+
+void ResourceUploadBatch::SetUploadCacheEnabled(bool enable)
+{
+    pImpl->SetUploadCacheEnabled(enable);
+}
+
+
+bool ResourceUploadBatch::IsUploadCacheEnabled() const noexcept
+{
+    return pImpl->IsUploadCacheEnabled();
+}
+
 
 void ResourceUploadBatch::GenerateMips(_In_ ID3D12Resource* resource)
 {
@@ -1130,6 +1946,19 @@ void ResourceUploadBatch::GenerateMips(_In_ ID3D12Resource* resource)
 }
 
 
+_Use_decl_annotations_
+void ResourceUploadBatch::GenerateMips(ID3D12Resource* const* resources, size_t count)
+{
+    pImpl->GenerateMips(resources, count);
+}
+
+
+ResourceUploadStatistics ResourceUploadBatch::GetStatistics() const noexcept
+{
+    return pImpl->GetStatistics();
+}
+
+
 _Use_decl_annotations_
 void ResourceUploadBatch::Transition(
     ID3D12Resource* resource,
@@ -1146,6 +1975,18 @@ std::future<void> ResourceUploadBatch::End(_In_ ID3D12CommandQueue* commandQueue
 }
 
 
+void ResourceUploadBatch::SetStagingBudget(size_t bytes, _In_opt_ ID3D12CommandQueue* commandQueue)
+{
+    pImpl->SetStagingBudget(bytes, commandQueue);
+}
+
+
+void ResourceUploadBatch::SetInFlightBudget(size_t bytes) noexcept
+{
+    pImpl->SetInFlightBudget(bytes);
+}
+
+
 bool ResourceUploadBatch::IsSupportedForGenerateMips(DXGI_FORMAT format) noexcept
 {
     return pImpl->IsSupportedForGenerateMips(format);
@@ -313,6 +313,9 @@ call :CompileShader%1 SpriteEffect ps SpritePixelShader
 call :CompileShader%1 SpriteEffect vs SpriteVertexShaderHeap
 call :CompileShader%1 SpriteEffect ps SpritePixelShaderHeap
 
+call :CompileShader%1 SpriteEffect vs SpriteVertexShaderInstanced
+call :CompileShader%1 SpriteEffect vs SpriteVertexShaderInstancedHeap
+
 call :CompileShader%1 PostProcess vs VSQuad
 call :CompileShader%1 PostProcess vs VSQuadNoCB
 call :CompileShader%1 PostProcess vs VSQuadDual
@@ -328,6 +331,7 @@ call :CompileShader%1 PostProcess ps PSMerge
 call :CompileShader%1 PostProcess ps PSBloomCombine
 
 call :CompileComputeShader%1 GenerateMips main
+call :CompileComputeShader%1 GenerateMips mainMulti
 
 call :CompileShader%1 ToneMap vs VSQuad
 call :CompileShader%1 ToneMap ps PSCopy
@@ -6,25 +6,83 @@
 #include "Structures.fxh"
 #include "RootSig.fxh"
 
-SamplerState Sampler       : register(s0);
-Texture2D<float4> SrcMip   : register(t0);
-RWTexture2D<float4> OutMip : register(u0);
+// Textures are bound as arrays so that texture arrays and cubemaps are processed with one
+// dispatch per mip level, using one z group per array slice
+SamplerState Sampler            : register(s0);
+Texture2DArray<float4> SrcMip   : register(t0);
+RWTexture2DArray<float4> OutMip : register(u0);
+
+// Further levels written by the single-pass shader
+RWTexture2DArray<float4> OutMip2 : register(u1);
+RWTexture2DArray<float4> OutMip3 : register(u2);
+RWTexture2DArray<float4> OutMip4 : register(u3);
 
 cbuffer MipConstants : register(b0)
 {
     float2 InvOutTexelSize; // texel size for OutMip (NOT SrcMip)
     uint SrcMipIndex;
+    uint NumMipLevels;      // levels written by mainMulti (1 to 4)
 }
 
-float4 Mip(uint2 coord)
+groupshared float4 Tile[64];
+
+float4 Mip(uint3 coord)
 {
     float2 uv = (coord.xy + 0.5) * InvOutTexelSize;
-    return SrcMip.SampleLevel(Sampler, uv, SrcMipIndex);
+    return SrcMip.SampleLevel(Sampler, float3(uv, coord.z), SrcMipIndex);
 }
 
 [RootSignature(GenerateMipsRS)]
 [numthreads(8, 8, 1)]
 void main(uint3 DTid : SV_DispatchThreadID)
 {
-    OutMip[DTid.xy] = Mip(DTid.xy);
+    OutMip[DTid] = Mip(DTid);
+}
+
+// Writes up to four levels per dispatch. Each 8x8 group reduces its block of the first level
+// in groupshared memory, so every level must be exactly half the size of the one before.
+[RootSignature(GenerateMipsRS)]
+[numthreads(8, 8, 1)]
+void mainMulti(uint3 DTid : SV_DispatchThreadID, uint GI : SV_GroupIndex)
+{
+    float4 color = Mip(DTid);
+    OutMip[DTid] = color;
+
+    if (NumMipLevels == 1)
+        return;
+
+    Tile[GI] = color;
+    GroupMemoryBarrierWithGroupSync();
+
+    // Threads with even x and y average a 2x2 block
+    if ((GI & 0x9) == 0)
+    {
+        color = 0.25 * (color + Tile[GI + 1] + Tile[GI + 8] + Tile[GI + 9]);
+        OutMip2[uint3(DTid.xy / 2, DTid.z)] = color;
+        Tile[GI] = color;
+    }
+
+    if (NumMipLevels == 2)
+        return;
+
+    GroupMemoryBarrierWithGroupSync();
+
+    // Threads with x and y multiples of 4 average a 2x2 block of the previous level
+    if ((GI & 0x1B) == 0)
+    {
+        color = 0.25 * (color + Tile[GI + 2] + Tile[GI + 16] + Tile[GI + 18]);
+        OutMip3[uint3(DTid.xy / 4, DTid.z)] = color;
+        Tile[GI] = color;
+    }
+
+    if (NumMipLevels == 3)
+        return;
+
+    GroupMemoryBarrierWithGroupSync();
+
+    if (GI == 0)
+    {
+        color = 0.25 * (color + Tile[4] + Tile[32] + Tile[36]);
+        OutMip4[uint3(DTid.xy / 8, DTid.z)] = color;
+    }
 }
@@ -44,3 +44,50 @@ float4 SpritePixelShaderHeap(float4 color    : COLOR0,
 {
     return Texture.Sample(TextureSampler, texCoord) * color;
 }
+
+
+// Instanced mode: each sprite is a single record, expanded into a quad here.
+struct SpriteInstance
+{
+    float4 source              : TEXCOORD1;    // Top left texture coordinate and size, negative when mirrored
+    float4 destination         : TEXCOORD2;    // Position and size in pixels
+    float4 originRotationDepth : TEXCOORD3;    // Origin as a fraction of the size, rotation, depth
+    float4 color               : COLOR0;
+};
+
+void ExpandSprite(uint vertexId, SpriteInstance instance,
+    out float4 color, out float2 texCoord, out float4 position)
+{
+    // Corners in the same order as the SpriteBatch index buffer
+    float2 corner = float2(vertexId & 1, vertexId >> 1);
+
+    float s, c;
+    sincos(instance.originRotationDepth.z, s, c);
+
+    float2 offset = (corner - instance.originRotationDepth.xy) * instance.destination.zw;
+    float2 pos = instance.destination.xy + offset.x * float2(c, s) + offset.y * float2(-s, c);
+
+    position = mul(float4(pos, instance.originRotationDepth.w, 1), MatrixTransform);
+    texCoord = instance.source.xy + corner * instance.source.zw;
+    color = instance.color;
+}
+
+[RootSignature(SpriteStaticRS)]
+void SpriteVertexShaderInstanced(uint vertexId : SV_VertexID,
+    SpriteInstance instance,
+    out float4 color    : COLOR0,
+    out float2 texCoord : TEXCOORD0,
+    out float4 position : SV_Position)
+{
+    ExpandSprite(vertexId, instance, color, texCoord, position);
+}
+
+[RootSignature(SpriteHeapRS)]
+void SpriteVertexShaderInstancedHeap(uint vertexId : SV_VertexID,
+    SpriteInstance instance,
+    out float4 color    : COLOR0,
+    out float2 texCoord : TEXCOORD0,
+    out float4 position : SV_Position)
+{
+    ExpandSprite(vertexId, instance, color, texCoord, position);
+}
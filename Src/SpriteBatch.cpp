@@ -11,6 +11,7 @@
 #include "SpriteBatch.h"
 
 #include "AlignedNew.h"
+#include "BenchmarkHooks.h"
 #include "CommonStates.h"
 #include "DirectXHelpers.h"
 #include "GraphicsMemory.h"
@@ -19,6 +20,8 @@
 #include "SharedResourcePool.h"
 #include "VertexTypes.h"
 
+#include <thread>
+
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
 
@@ -30,21 +33,29 @@ namespace
 #include "XboxGamingScarlettSpriteEffect_SpritePixelShader.inc"
 #include "XboxGamingScarlettSpriteEffect_SpriteVertexShaderHeap.inc"
 #include "XboxGamingScarlettSpriteEffect_SpritePixelShaderHeap.inc"
+#include "XboxGamingScarlettSpriteEffect_SpriteVertexShaderInstanced.inc"
+#include "XboxGamingScarlettSpriteEffect_SpriteVertexShaderInstancedHeap.inc"
 #elif defined(_GAMING_XBOX)
 #include "XboxGamingXboxOneSpriteEffect_SpriteVertexShader.inc"
 #include "XboxGamingXboxOneSpriteEffect_SpritePixelShader.inc"
 #include "XboxGamingXboxOneSpriteEffect_SpriteVertexShaderHeap.inc"
 #include "XboxGamingXboxOneSpriteEffect_SpritePixelShaderHeap.inc"
+#include "XboxGamingXboxOneSpriteEffect_SpriteVertexShaderInstanced.inc"
+#include "XboxGamingXboxOneSpriteEffect_SpriteVertexShaderInstancedHeap.inc"
 #elif defined(_XBOX_ONE) && defined(_TITLE)
 #include "XboxOneSpriteEffect_SpriteVertexShader.inc"
 #include "XboxOneSpriteEffect_SpritePixelShader.inc"
 #include "XboxOneSpriteEffect_SpriteVertexShaderHeap.inc"
 #include "XboxOneSpriteEffect_SpritePixelShaderHeap.inc"
+#include "XboxOneSpriteEffect_SpriteVertexShaderInstanced.inc"
+#include "XboxOneSpriteEffect_SpriteVertexShaderInstancedHeap.inc"
 #else
 #include "SpriteEffect_SpriteVertexShader.inc"
 #include "SpriteEffect_SpritePixelShader.inc"
 #include "SpriteEffect_SpriteVertexShaderHeap.inc"
 #include "SpriteEffect_SpritePixelShaderHeap.inc"
+#include "SpriteEffect_SpriteVertexShaderInstanced.inc"
+#include "SpriteEffect_SpriteVertexShaderInstancedHeap.inc"
 #endif
 
     inline bool operator != (D3D12_GPU_DESCRIPTOR_HANDLE a, D3D12_GPU_DESCRIPTOR_HANDLE b) noexcept
@@ -68,7 +79,33 @@ namespace
 
         return v;
     }
+
+    // Maps a float to an unsigned integer with the same ordering.
+    inline uint32_t FloatSortKey(float value) noexcept
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+
+        return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+    }
+
+#ifdef DIRECTX_TOOLKIT_BENCHMARK_HOOKS
+    std::atomic<bool> s_scalarVertices(false);
+    std::atomic<bool> s_comparisonSort(false);
+#endif
+}
+
+#ifdef DIRECTX_TOOLKIT_BENCHMARK_HOOKS
+void __cdecl DirectX::BenchmarkHooks::SetSpriteBatchScalarVertices(bool enable) noexcept
+{
+    s_scalarVertices.store(enable);
+}
+
+void __cdecl DirectX::BenchmarkHooks::SetSpriteBatchComparisonSort(bool enable) noexcept
+{
+    s_comparisonSort.store(enable);
 }
+#endif
 
 // Internal SpriteBatch implementation class.
 XM_ALIGNED_STRUCT(16) SpriteBatch::Impl : public AlignedNew<SpriteBatch::Impl>
@@ -118,6 +155,15 @@ public:
         static_assert((SpriteEffects_FlipBoth & (SourceInTexels | DestSizeInPixels)) == 0, "Flag bits must not overlap");
     };
 
+    // Per-sprite record for instanced mode, expanded into a quad by the vertex shader.
+    struct SpriteInstance
+    {
+        XMFLOAT4 source;                // Top left texture coordinate and size, negative when mirrored
+        XMFLOAT4 destination;           // Position and size in pixels
+        XMFLOAT4 originRotationDepth;   // Origin as a fraction of the size, rotation, depth
+        XMFLOAT4 color;
+    };
+
     DXGI_MODE_ROTATION mRotation;
 
     bool mSetViewport;
@@ -127,31 +173,129 @@ public:
 
     XMMATRIX GetViewportTransform(_In_ DXGI_MODE_ROTATION rotation);
 
+    // Sprites and vertex data captured by BeginRetained.
+    struct RetainedSprites;
+
+    void BeginRetained(
+        _In_ RetainedSprites* retained,
+        size_t firstSprite,
+        size_t spriteCount,
+        SpriteSortMode sortMode,
+        bool update);
+
+    void XM_CALLCONV DrawRetained(
+        _In_ ID3D12GraphicsCommandList* commandList,
+        RetainedSprites const& retained,
+        FXMMATRIX transformMatrix);
+
 private:
     // Implementation helper methods.
     void GrowSpriteQueue();
     void PrepareForRendering();
     void FlushBatch();
     void SortSprites();
+    void RadixSortSprites();
     void GrowSortedSprites();
 
+#ifdef DIRECTX_TOOLKIT_BENCHMARK_HOOKS
+    void ComparisonSortSprites();
+#endif
+
+    // Sprites drawn between Begin and End from threads other than the one which called Begin.
+    struct ThreadQueue
+    {
+        std::thread::id owner;
+        std::unique_ptr<SpriteInfo[]> sprites;
+        size_t count;
+        size_t arraySize;
+    };
+
+    struct ThreadQueueList
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadQueue>> queues;
+        size_t active;  // Queues in use by the current batch
+    };
+
+    // Remembers which queue the calling thread used for the batch it last drew into.
+    struct ThreadQueueCache
+    {
+        uint64_t batchId;
+        ThreadQueue* queue;
+    };
+
+    ThreadQueue* GetThreadQueue();
+    void MergeThreadQueues();
+
+    // A draw call covering a contiguous range of sprites which share a texture.
+    struct SpriteDraw
+    {
+        D3D12_GPU_DESCRIPTOR_HANDLE texture;
+        XMFLOAT2 textureSize;
+        SpriteInfo const* const* sprites;
+        size_t count;
+        void* memory;
+        D3D12_GPU_VIRTUAL_ADDRESS gpuAddress;
+    };
+
+    // A slice of a draw call's vertex generation, for worker threads.
+    struct VertexJob
+    {
+        size_t draw;
+        size_t first;
+        size_t count;
+    };
+
     void RenderBatch(
         D3D12_GPU_DESCRIPTOR_HANDLE texture,
         XMVECTOR textureSize,
         _In_reads_(count) SpriteInfo const* const* sprites,
         size_t count);
 
+    void QueueDraws(
+        D3D12_GPU_DESCRIPTOR_HANDLE texture,
+        XMVECTOR textureSize,
+        _In_reads_(count) SpriteInfo const* const* sprites,
+        size_t count,
+        size_t queuedCount);
+
+    void GenerateVertices(SpriteDraw const& draw, size_t first, size_t count) const noexcept;
+    void GenerateQueuedVertices();
+    void RunVertexJobs() noexcept;
+
+    static void CALLBACK VertexWorkCallback(PTP_CALLBACK_INSTANCE, PVOID context, PTP_WORK) noexcept;
+    void SubmitDraws();
+    void RecordDraws(std::vector<SpriteDraw> const& draws);
+
+    void EndRetained();
+
     static void XM_CALLCONV RenderSprite(_In_ SpriteInfo const* sprite,
         _Out_writes_(VerticesPerSprite) VertexPositionColorTexture* vertices,
         FXMVECTOR textureSize,
         FXMVECTOR inverseTextureSize) noexcept;
 
+    static void XM_CALLCONV RenderSpriteGroup(_In_reads_(SpritesPerGroup) SpriteInfo const* const* sprites,
+        _Out_writes_(VerticesPerSprite * SpritesPerGroup) VertexPositionColorTexture* vertices,
+        FXMVECTOR textureSize,
+        FXMVECTOR inverseTextureSize) noexcept;
+
+    static void XM_CALLCONV RenderSpriteInstance(_In_ SpriteInfo const* sprite,
+        _Out_ SpriteInstance* instance,
+        FXMVECTOR textureSize,
+        FXMVECTOR inverseTextureSize) noexcept;
+
     // Constants.
     static constexpr size_t MaxBatchSize = 2048;
+    static constexpr size_t MaxInstancedBatchSize = 16384;
     static constexpr size_t MinBatchSize = 128;
     static constexpr size_t InitialQueueSize = 64;
     static constexpr size_t VerticesPerSprite = 4;
     static constexpr size_t IndicesPerSprite = 6;
+    static constexpr size_t SpritesPerGroup = 4;
+    static constexpr size_t ParallelVertexThreshold = 16384;
+    static constexpr size_t ParallelVertexChunkSize = 2048;
+
+    static_assert((ParallelVertexChunkSize % SpritesPerGroup) == 0, "Chunks must hold whole sprite groups");
 
     //
     // The following functions and members are used to create the default pipeline state objects.
@@ -160,7 +304,11 @@ private:
     static const D3D12_SHADER_BYTECODE s_DefaultPixelShaderByteCodeStatic;
     static const D3D12_SHADER_BYTECODE s_DefaultVertexShaderByteCodeHeap;
     static const D3D12_SHADER_BYTECODE s_DefaultPixelShaderByteCodeHeap;
+    static const D3D12_SHADER_BYTECODE s_InstancedVertexShaderByteCodeStatic;
+    static const D3D12_SHADER_BYTECODE s_InstancedVertexShaderByteCodeHeap;
     static const D3D12_INPUT_LAYOUT_DESC s_DefaultInputLayoutDesc;
+    static const D3D12_INPUT_ELEMENT_DESC s_InstancedInputElements[];
+    static const D3D12_INPUT_LAYOUT_DESC s_InstancedInputLayoutDesc;
 
 
     // Queue of sprites waiting to be drawn.
@@ -176,8 +324,37 @@ private:
     // mSpriteQueue array, and we take care to keep them in order when sorting is disabled.
     std::vector<SpriteInfo const*> mSortedSprites;
 
+    // Sort keys extracted from the queued sprites, plus the same again as scratch space for RadixSortSprites.
+    struct SortEntry
+    {
+        uint64_t key;
+        SpriteInfo const* sprite;
+    };
+
+    std::vector<SortEntry> mSortEntries;
+
+    // Per-digit counts for RadixSortSprites, one byte of the 64-bit key per digit.
+    static constexpr size_t SortDigitCount = sizeof(uint64_t);
+    static constexpr size_t SortRadixSize = 256;
+
+    std::array<size_t, SortDigitCount * SortRadixSize> mSortHistograms;
+
+    // Queues for sprites drawn from other threads, merged into mSpriteQueue at End.
+    std::unique_ptr<ThreadQueueList> mThreadQueues;
+    std::thread::id mRecordingThread;
+    uint64_t mBatchId;
+
+    // Retained batch being captured between BeginRetained and End.
+    RetainedSprites* mRetained;
+    size_t mRetainedFirst;
+    size_t mRetainedCount;
+
+    static thread_local ThreadQueueCache s_threadQueueCache;
+    static std::atomic<uint64_t> s_nextBatchId;
+
     // Custom flags.
     bool mCustomCBV;
+    bool mInstanced;
 
     // Mode settings from the last Begin call.
     bool mInBeginEndPair;
@@ -190,7 +367,13 @@ private:
 
     // Batched data
     GraphicsResource mVertexSegment;
-    size_t mVertexPageSize;
+    std::vector<GraphicsResource> mRetainedSegments;
+    std::vector<SpriteDraw> mDraws;
+    std::vector<VertexJob> mVertexJobs;
+    std::atomic<size_t> mNextVertexJob;
+    ScopedThreadpoolWork mVertexWork;
+    size_t mVertexSegmentCapacity;
+    size_t mMaxBatchSize;
     size_t mSpriteCount;
     GraphicsResource mConstantBuffer;
 
@@ -226,9 +409,30 @@ private:
 };
 
 
+struct SpriteBatch::Impl::RetainedSprites
+{
+    RetainedSprites() : instanced(false) {}
+
+    std::vector<SpriteInfo> sprites;
+    std::vector<uint8_t> vertices;      // Copy of the vertex data, so updates only need to regenerate changed sprites
+    std::vector<SpriteDraw> draws;
+    GraphicsResource vertexBuffer;
+    bool instanced;
+};
+
+
+// The public Retained class only hides the captured state from the header.
+struct SpriteBatch::Retained::Impl : public SpriteBatch::Impl::RetainedSprites
+{
+};
+
+
 // Global pools of per-device and per-context SpriteBatch resources.
 SharedResourcePool<ID3D12Device*, SpriteBatch::Impl::DeviceResources, ResourceUploadBatch&> SpriteBatch::Impl::deviceResourcesPool;
 
+thread_local SpriteBatch::Impl::ThreadQueueCache SpriteBatch::Impl::s_threadQueueCache = {};
+std::atomic<uint64_t> SpriteBatch::Impl::s_nextBatchId(1);
+
 
 // Constants.
 const XMMATRIX SpriteBatch::MatrixIdentity = XMMatrixIdentity();
@@ -242,6 +446,23 @@ const D3D12_SHADER_BYTECODE SpriteBatch::Impl::s_DefaultPixelShaderByteCodeHeap
 
 const D3D12_INPUT_LAYOUT_DESC SpriteBatch::Impl::s_DefaultInputLayoutDesc = VertexPositionColorTexture::InputLayout;
 
+const D3D12_SHADER_BYTECODE SpriteBatch::Impl::s_InstancedVertexShaderByteCodeStatic = { SpriteEffect_SpriteVertexShaderInstanced, sizeof(SpriteEffect_SpriteVertexShaderInstanced) };
+const D3D12_SHADER_BYTECODE SpriteBatch::Impl::s_InstancedVertexShaderByteCodeHeap = { SpriteEffect_SpriteVertexShaderInstancedHeap, sizeof(SpriteEffect_SpriteVertexShaderInstancedHeap) };
+
+const D3D12_INPUT_ELEMENT_DESC SpriteBatch::Impl::s_InstancedInputElements[] =
+{
+    { "TEXCOORD",   1, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+    { "TEXCOORD",   2, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+    { "TEXCOORD",   3, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+    { "COLOR",      0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+};
+
+const D3D12_INPUT_LAYOUT_DESC SpriteBatch::Impl::s_InstancedInputLayoutDesc =
+{
+    SpriteBatch::Impl::s_InstancedInputElements,
+    static_cast<UINT>(std::size(SpriteBatch::Impl::s_InstancedInputElements))
+};
+
 // Matches CommonStates::AlphaBlend
 const D3D12_BLEND_DESC SpriteBatchPipelineStateDescription::s_DefaultBlendDesc =
 {
@@ -441,12 +662,21 @@ SpriteBatch::Impl::Impl(ID3D12Device* device,
     mSampler{},
     mSpriteQueueCount(0),
     mSpriteQueueArraySize(0),
+    mSortHistograms{},
     mCustomCBV(false),
+    mInstanced(psoDesc.instanced),
+    mThreadQueues(std::make_unique<ThreadQueueList>()),
+    mBatchId(0),
+    mRetained(nullptr),
+    mRetainedFirst(0),
+    mRetainedCount(0),
     mInBeginEndPair(false),
     mSortMode(SpriteSortMode_Deferred),
     mTransformMatrix(MatrixIdentity),
     mVertexSegment{},
-    mVertexPageSize(sizeof(VertexPositionColorTexture) * MaxBatchSize * VerticesPerSprite),
+    mNextVertexJob(0),
+    mVertexSegmentCapacity(0),
+    mMaxBatchSize(MaxBatchSize),
     mSpriteCount(0),
     mDeviceResources{}
 {
@@ -461,8 +691,14 @@ SpriteBatch::Impl::Impl(ID3D12Device* device,
 
     mDeviceResources = deviceResourcesPool.DemandCreate(device, upload);
 
+    if (mInstanced)
+    {
+        // Each instance is drawn with the first IndicesPerSprite entries of the index buffer
+        mMaxBatchSize = MaxInstancedBatchSize;
+    }
+
     D3D12_GRAPHICS_PIPELINE_STATE_DESC d3dDesc = {};
-    d3dDesc.InputLayout = s_DefaultInputLayoutDesc;
+    d3dDesc.InputLayout = mInstanced ? s_InstancedInputLayoutDesc : s_DefaultInputLayoutDesc;
     d3dDesc.BlendState = psoDesc.blendDesc;
     d3dDesc.DepthStencilState = psoDesc.depthStencilDesc;
     d3dDesc.RasterizerState = psoDesc.rasterizerDesc;
@@ -491,6 +727,10 @@ SpriteBatch::Impl::Impl(ID3D12Device* device,
     {
         d3dDesc.VS = psoDesc.customVertexShader;
     }
+    else if (mInstanced)
+    {
+        d3dDesc.VS = (psoDesc.samplerDescriptor.ptr) ? s_InstancedVertexShaderByteCodeHeap : s_InstancedVertexShaderByteCodeStatic;
+    }
     else
     {
         d3dDesc.VS = (psoDesc.samplerDescriptor.ptr) ? s_DefaultVertexShaderByteCodeHeap : s_DefaultVertexShaderByteCodeStatic;
@@ -534,6 +774,8 @@ void XM_CALLCONV SpriteBatch::Impl::Begin(
     mTransformMatrix = transformMatrix;
     mCommandList = commandList;
     mSpriteCount = 0;
+    mRecordingThread = std::this_thread::get_id();
+    mBatchId = s_nextBatchId.fetch_add(1);
 
     if (sortMode == SpriteSortMode_Immediate)
     {
@@ -552,8 +794,13 @@ void SpriteBatch::Impl::End()
         throw std::logic_error("SpriteBatch::End");
     }
 
-    if (mSortMode != SpriteSortMode_Immediate)
+    if (mRetained)
+    {
+        EndRetained();
+    }
+    else if (mSortMode != SpriteSortMode_Immediate)
     {
+        MergeThreadQueues();
         PrepareForRendering();
         FlushBatch();
     }
@@ -567,6 +814,194 @@ void SpriteBatch::Impl::End()
 
     mInBeginEndPair = false;
     mCommandList = nullptr;
+    mRetained = nullptr;
+}
+
+
+// Begins capturing sprites into a retained batch. Updates replace spriteCount sprites from firstSprite.
+_Use_decl_annotations_
+void SpriteBatch::Impl::BeginRetained(
+    RetainedSprites* retained,
+    size_t firstSprite,
+    size_t spriteCount,
+    SpriteSortMode sortMode,
+    bool update)
+{
+    if (mInBeginEndPair)
+    {
+        DebugTrace("ERROR: Cannot nest Begin calls on a single SpriteBatch\n");
+        throw std::logic_error("SpriteBatch::BeginRetained");
+    }
+
+    if (sortMode == SpriteSortMode_Immediate)
+        throw std::invalid_argument("Retained sprites cannot use SpriteSortMode_Immediate");
+
+    if (update)
+    {
+        if (firstSprite > retained->sprites.size() || spriteCount > retained->sprites.size() - firstSprite)
+            throw std::out_of_range("Invalid sprite range for BeginRetainedUpdate");
+
+        if (!retained->sprites.empty() && retained->instanced != mInstanced)
+        {
+            DebugTrace("ERROR: Retained sprites were captured by a SpriteBatch with a different instanced setting\n");
+            throw std::logic_error("SpriteBatch::BeginRetainedUpdate");
+        }
+    }
+    else
+    {
+        retained->sprites.clear();
+        retained->vertices.clear();
+        firstSprite = 0;
+        spriteCount = 0;
+    }
+
+    mSortMode = sortMode;
+    mCommandList = nullptr;
+    mRecordingThread = std::this_thread::get_id();
+    mBatchId = s_nextBatchId.fetch_add(1);
+    mRetained = retained;
+    mRetainedFirst = firstSprite;
+    mRetainedCount = spriteCount;
+
+    mInBeginEndPair = true;
+}
+
+
+// Copies the captured sprites into the retained batch, generates their vertices and uploads the result.
+void SpriteBatch::Impl::EndRetained()
+{
+    auto& retained = *mRetained;
+
+    MergeThreadQueues();
+
+    const size_t spriteStride = mInstanced
+        ? sizeof(SpriteInstance)
+        : sizeof(VertexPositionColorTexture) * VerticesPerSprite;
+
+    const size_t first = mRetainedFirst;
+    const size_t replaced = mRetainedCount;
+    const size_t count = mSpriteQueueCount;
+
+    // The drawn sprites replace the range [first, first + replaced). Sprites after the range
+    // keep their vertices, which only move if the number of sprites changed.
+    if (count > replaced)
+    {
+        retained.sprites.insert(retained.sprites.begin() + ptrdiff_t(first + replaced), count - replaced, SpriteInfo{});
+        retained.vertices.insert(retained.vertices.begin() + ptrdiff_t((first + replaced) * spriteStride), (count - replaced) * spriteStride, uint8_t(0));
+    }
+    else if (count < replaced)
+    {
+        retained.sprites.erase(retained.sprites.begin() + ptrdiff_t(first + count), retained.sprites.begin() + ptrdiff_t(first + replaced));
+        retained.vertices.erase(retained.vertices.begin() + ptrdiff_t((first + count) * spriteStride), retained.vertices.begin() + ptrdiff_t((first + replaced) * spriteStride));
+    }
+
+    retained.instanced = mInstanced;
+
+    if (count > 0)
+    {
+        SortSprites();
+
+        for (size_t i = 0; i < count; i++)
+        {
+            retained.sprites[first + i] = *mSortedSprites[i];
+            mSortedSprites[i] = &retained.sprites[first + i];
+        }
+
+        // Generate vertices for the sprites which were drawn, one run per texture.
+        size_t runStart = 0;
+
+        for (size_t pos = 1; pos <= count; pos++)
+        {
+            if (pos == count || mSortedSprites[pos]->texture != mSortedSprites[runStart]->texture)
+            {
+                SpriteDraw draw = {};
+                draw.texture = mSortedSprites[runStart]->texture;
+                XMStoreFloat2(&draw.textureSize, mSortedSprites[runStart]->textureSize);
+                draw.sprites = &mSortedSprites[runStart];
+                draw.count = pos - runStart;
+                draw.memory = retained.vertices.data() + (first + runStart) * spriteStride;
+
+                mDraws.push_back(draw);
+
+                runStart = pos;
+            }
+        }
+
+        GenerateQueuedVertices();
+        mDraws.clear();
+
+        // mSortedSprites now points into the retained batch rather than mSpriteQueue.
+        mSortedSprites.clear();
+        mSpriteQueueCount = 0;
+    }
+
+    // The previous vertex buffer may still be in use by the GPU, so the vertices are copied
+    // to a new one rather than being updated in place.
+    retained.draws.clear();
+    retained.vertexBuffer.Reset();
+
+    if (retained.sprites.empty())
+        return;
+
+    // The buffer is kept across many frames, so it is sized to come from a page rather than
+    // the ring buffer, where it would stop the whole ring chunk from being reused.
+    const size_t bufferSize = std::max(retained.vertices.size(), GraphicsMemory::RingBufferAllocationLimit);
+
+    retained.vertexBuffer = GraphicsMemory::Get(mDeviceResources->mDevice).Allocate(bufferSize, 16, GraphicsMemory::TAG_SPRITES);
+    memcpy(retained.vertexBuffer.Memory(), retained.vertices.data(), retained.vertices.size());
+
+    // Build the draw calls, splitting whenever the texture changes or a draw reaches the batch size limit.
+    const size_t total = retained.sprites.size();
+    size_t runStart = 0;
+
+    for (size_t pos = 1; pos <= total; pos++)
+    {
+        if (pos == total
+            || retained.sprites[pos].texture != retained.sprites[runStart].texture
+            || pos - runStart == mMaxBatchSize)
+        {
+            SpriteDraw draw = {};
+            draw.texture = retained.sprites[runStart].texture;
+            draw.count = pos - runStart;
+            draw.gpuAddress = retained.vertexBuffer.GpuAddress() + (UINT64(runStart) * UINT64(spriteStride));
+
+            retained.draws.push_back(draw);
+
+            runStart = pos;
+        }
+    }
+}
+
+
+// Draws a retained batch.
+_Use_decl_annotations_
+void XM_CALLCONV SpriteBatch::Impl::DrawRetained(
+    ID3D12GraphicsCommandList* commandList,
+    RetainedSprites const& retained,
+    FXMMATRIX transformMatrix)
+{
+    if (mInBeginEndPair)
+    {
+        DebugTrace("ERROR: Cannot draw retained sprites between Begin and End\n");
+        throw std::logic_error("SpriteBatch::DrawRetained");
+    }
+
+    if (retained.draws.empty())
+        return;
+
+    if (retained.instanced != mInstanced)
+    {
+        DebugTrace("ERROR: Retained sprites were captured by a SpriteBatch with a different instanced setting\n");
+        throw std::logic_error("SpriteBatch::DrawRetained");
+    }
+
+    mTransformMatrix = transformMatrix;
+    mCommandList = commandList;
+
+    PrepareForRendering();
+    RecordDraws(retained.draws);
+
+    mCommandList = nullptr;
 }
 
 
@@ -590,12 +1025,46 @@ void XM_CALLCONV SpriteBatch::Impl::Draw(D3D12_GPU_DESCRIPTOR_HANDLE texture,
         throw std::invalid_argument("Invalid texture for Draw");
 
     // Get a pointer to the output sprite.
-    if (mSpriteQueueCount >= mSpriteQueueArraySize)
+    SpriteInfo* sprite;
+    ThreadQueue* threadQueue = nullptr;
+
+    if (std::this_thread::get_id() == mRecordingThread)
     {
-        GrowSpriteQueue();
+        if (mSpriteQueueCount >= mSpriteQueueArraySize)
+        {
+            GrowSpriteQueue();
+        }
+
+        sprite = &mSpriteQueue[mSpriteQueueCount];
     }
+    else
+    {
+        // Other threads record into queues of their own, which are merged at End.
+        if (mSortMode == SpriteSortMode_Immediate)
+        {
+            DebugTrace("ERROR: Draw can only be called from other threads when the sort mode is not SpriteSortMode_Immediate\n");
+            throw std::logic_error("SpriteBatch::Draw");
+        }
+
+        threadQueue = GetThreadQueue();
+
+        if (threadQueue->count >= threadQueue->arraySize)
+        {
+            const size_t newSize = std::max(InitialQueueSize, threadQueue->arraySize * 2);
+
+            auto newArray = std::make_unique<SpriteInfo[]>(newSize);
+
+            for (size_t i = 0; i < threadQueue->count; i++)
+            {
+                newArray[i] = threadQueue->sprites[i];
+            }
 
-    SpriteInfo* sprite = &mSpriteQueue[mSpriteQueueCount];
+            threadQueue->sprites = std::move(newArray);
+            threadQueue->arraySize = newSize;
+        }
+
+        sprite = &threadQueue->sprites[threadQueue->count];
+    }
 
     XMVECTOR dest = destination;
 
@@ -634,7 +1103,11 @@ void XM_CALLCONV SpriteBatch::Impl::Draw(D3D12_GPU_DESCRIPTOR_HANDLE texture,
     sprite->textureSize = textureSizeV;
     sprite->flags = flags;
 
-    if (mSortMode == SpriteSortMode_Immediate)
+    if (threadQueue)
+    {
+        threadQueue->count++;
+    }
+    else if (mSortMode == SpriteSortMode_Immediate)
     {
         // If we are in immediate mode, draw this sprite straight away.
         RenderBatch(texture, textureSizeV, &sprite, 1);
@@ -671,6 +1144,75 @@ void SpriteBatch::Impl::GrowSpriteQueue()
 }
 
 
+// Finds or creates the queue the calling thread records into for the current batch.
+SpriteBatch::Impl::ThreadQueue* SpriteBatch::Impl::GetThreadQueue()
+{
+    auto& cache = s_threadQueueCache;
+    if (cache.batchId == mBatchId)
+        return cache.queue;
+
+    const std::thread::id thread = std::this_thread::get_id();
+
+    std::lock_guard<std::mutex> lock(mThreadQueues->mutex);
+
+    auto& queues = mThreadQueues->queues;
+
+    ThreadQueue* queue = nullptr;
+    for (size_t j = 0; j < mThreadQueues->active; j++)
+    {
+        if (queues[j]->owner == thread)
+        {
+            queue = queues[j].get();
+            break;
+        }
+    }
+
+    if (!queue)
+    {
+        if (mThreadQueues->active == queues.size())
+        {
+            queues.emplace_back(std::make_unique<ThreadQueue>());
+            queues.back()->arraySize = 0;
+        }
+
+        queue = queues[mThreadQueues->active++].get();
+        queue->owner = thread;
+        queue->count = 0;
+    }
+
+    cache.batchId = mBatchId;
+    cache.queue = queue;
+
+    return queue;
+}
+
+
+// Appends the sprites recorded by other threads to mSpriteQueue, in the order the threads first drew.
+void SpriteBatch::Impl::MergeThreadQueues()
+{
+    std::lock_guard<std::mutex> lock(mThreadQueues->mutex);
+
+    for (size_t j = 0; j < mThreadQueues->active; j++)
+    {
+        auto& queue = *mThreadQueues->queues[j];
+
+        while (mSpriteQueueCount + queue.count > mSpriteQueueArraySize)
+        {
+            GrowSpriteQueue();
+        }
+
+        for (size_t i = 0; i < queue.count; i++)
+        {
+            mSpriteQueue[mSpriteQueueCount++] = queue.sprites[i];
+        }
+
+        queue.count = 0;
+    }
+
+    mThreadQueues->active = 0;
+}
+
+
 // Sets up D3D device state ready for drawing sprites.
 void SpriteBatch::Impl::PrepareForRendering()
 {
@@ -729,7 +1271,7 @@ void SpriteBatch::Impl::FlushBatch()
         {
             if (pos > batchStart)
             {
-                RenderBatch(batchTexture, batchTextureSize, &mSortedSprites[batchStart], pos - batchStart);
+                QueueDraws(batchTexture, batchTextureSize, &mSortedSprites[batchStart], pos - batchStart, mSpriteQueueCount - batchStart);
             }
 
             batchTexture = texture;
@@ -739,7 +1281,10 @@ void SpriteBatch::Impl::FlushBatch()
     }
 
     // Flush the final batch.
-    RenderBatch(batchTexture, batchTextureSize, &mSortedSprites[batchStart], mSpriteQueueCount - batchStart);
+    QueueDraws(batchTexture, batchTextureSize, &mSortedSprites[batchStart], mSpriteQueueCount - batchStart, mSpriteQueueCount - batchStart);
+
+    GenerateQueuedVertices();
+    SubmitDraws();
 
     // Reset the queue.
     mSpriteQueueCount = 0;
@@ -766,39 +1311,146 @@ void SpriteBatch::Impl::SortSprites()
     switch (mSortMode)
     {
     case SpriteSortMode_Texture:
-        // Sort by texture.
-        std::sort(mSortedSprites.begin(),
-            mSortedSprites.begin() + static_cast<int>(mSpriteQueueCount),
-            [](SpriteInfo const* x, SpriteInfo const* y) noexcept -> bool
-            {
-                return x->texture < y->texture;
-            });
+    case SpriteSortMode_BackToFront:
+    case SpriteSortMode_FrontToBack:
+    #ifdef DIRECTX_TOOLKIT_BENCHMARK_HOOKS
+        if (s_comparisonSort.load(std::memory_order_relaxed))
+        {
+            ComparisonSortSprites();
+            break;
+        }
+    #endif
+        RadixSortSprites();
         break;
 
-    case SpriteSortMode_BackToFront:
-        // Sort back to front.
-        std::sort(mSortedSprites.begin(),
-            mSortedSprites.begin() + static_cast<int>(mSpriteQueueCount),
-            [](SpriteInfo const* x, SpriteInfo const* y) noexcept -> bool
-            {
-                return x->originRotationDepth.w > y->originRotationDepth.w;
-            });
+    default:
         break;
+    }
+}
 
-    case SpriteSortMode_FrontToBack:
-        // Sort front to back.
-        std::sort(mSortedSprites.begin(),
+
+// Sorts the queued sprites on a key extracted once per sprite, using a least significant
+// digit radix sort. Passes in which every key has the same digit are skipped, so only the
+// bytes that vary cost anything. The sort is stable, so sprites with equal keys are drawn
+// in the order they were queued.
+void SpriteBatch::Impl::RadixSortSprites()
+{
+    const size_t count = mSpriteQueueCount;
+    if (count < 2)
+        return;
+
+    mSortEntries.resize(count * 2);
+
+    SortEntry* src = mSortEntries.data();
+    SortEntry* dst = src + count;
+
+    // Extract the keys.
+    for (size_t i = 0; i < count; i++)
+    {
+        SpriteInfo const* sprite = mSortedSprites[i];
+
+        uint64_t key;
+        switch (mSortMode)
+        {
+        case SpriteSortMode_Texture:
+            key = sprite->texture.ptr;
+            break;
+
+        case SpriteSortMode_BackToFront:
+            key = ~FloatSortKey(sprite->originRotationDepth.w);
+            break;
+
+        default:
+            key = FloatSortKey(sprite->originRotationDepth.w);
+            break;
+        }
+
+        src[i].key = key;
+        src[i].sprite = sprite;
+    }
+
+    // Count every digit of every key in a single pass.
+    mSortHistograms.fill(0);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const uint64_t key = src[i].key;
+
+        for (size_t digit = 0; digit < SortDigitCount; digit++)
+        {
+            ++mSortHistograms[digit * SortRadixSize + ((key >> (digit * 8)) & 0xFF)];
+        }
+    }
+
+    for (size_t digit = 0; digit < SortDigitCount; digit++)
+    {
+        size_t* histogram = &mSortHistograms[digit * SortRadixSize];
+        const unsigned int shift = static_cast<unsigned int>(digit * 8);
+
+        // Skip the pass if every key has the same value for this digit.
+        if (histogram[(src[0].key >> shift) & 0xFF] == count)
+            continue;
+
+        // Turn the counts into starting offsets.
+        size_t offset = 0;
+        for (size_t j = 0; j < SortRadixSize; j++)
+        {
+            const size_t n = histogram[j];
+            histogram[j] = offset;
+            offset += n;
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            dst[histogram[(src[i].key >> shift) & 0xFF]++] = src[i];
+        }
+
+        std::swap(src, dst);
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        mSortedSprites[i] = src[i].sprite;
+    }
+}
+
+
+#ifdef DIRECTX_TOOLKIT_BENCHMARK_HOOKS
+// Sorts the queued sprites with std::sort on the sprite pointers, as before the radix sort,
+// so the benchmarks can compare the two.
+void SpriteBatch::Impl::ComparisonSortSprites()
+{
+    switch (mSortMode)
+    {
+    case SpriteSortMode_Texture:
+        std::sort(mSortedSprites.begin(),
             mSortedSprites.begin() + static_cast<int>(mSpriteQueueCount),
             [](SpriteInfo const* x, SpriteInfo const* y) noexcept -> bool
             {
-                return x->originRotationDepth.w < y->originRotationDepth.w;
+                return x->texture < y->texture;
+            });
+        break;
+
+    case SpriteSortMode_BackToFront:
+        std::sort(mSortedSprites.begin(),
+            mSortedSprites.begin() + static_cast<int>(mSpriteQueueCount),
+            [](SpriteInfo const* x, SpriteInfo const* y) noexcept -> bool
+            {
+                return x->originRotationDepth.w > y->originRotationDepth.w;
             });
         break;
 
     default:
+        std::sort(mSortedSprites.begin(),
+            mSortedSprites.begin() + static_cast<int>(mSpriteQueueCount),
+            [](SpriteInfo const* x, SpriteInfo const* y) noexcept -> bool
+            {
+                return x->originRotationDepth.w < y->originRotationDepth.w;
+            });
         break;
     }
 }
+#endif
 
 
 // Populates the mSortedSprites vector with pointers to individual elements of the mSpriteQueue array.
@@ -819,19 +1471,29 @@ void SpriteBatch::Impl::GrowSortedSprites()
 _Use_decl_annotations_
 void SpriteBatch::Impl::RenderBatch(D3D12_GPU_DESCRIPTOR_HANDLE texture, XMVECTOR textureSize, SpriteInfo const* const* sprites, size_t count)
 {
-    auto commandList = mCommandList.Get();
+    QueueDraws(texture, textureSize, sprites, count, count);
+    GenerateQueuedVertices();
+    SubmitDraws();
+}
 
-    // Draw using the specified texture.
-    // **NOTE** If D3D asserts or crashes here, you probably need to call commandList->SetDescriptorHeaps() with the required descriptor heap(s)
-    commandList->SetGraphicsRootDescriptorTable(RootParameterIndex::TextureSRV, texture);
 
-    if (mSampler.ptr)
-    {
-        commandList->SetGraphicsRootDescriptorTable(RootParameterIndex::TextureSampler, mSampler);
-    }
+// Splits a run of sprites which share a texture into draw calls, and reserves vertex memory for them.
+// queuedCount is the number of sprites still to be queued by this flush, including this run.
+_Use_decl_annotations_
+void SpriteBatch::Impl::QueueDraws(D3D12_GPU_DESCRIPTOR_HANDLE texture, XMVECTOR textureSize, SpriteInfo const* const* sprites, size_t count, size_t queuedCount)
+{
+    const size_t spriteStride = mInstanced
+        ? sizeof(SpriteInstance)
+        : sizeof(VertexPositionColorTexture) * VerticesPerSprite;
 
-    // Convert to vector format.
-    const XMVECTOR inverseTextureSize = XMVectorReciprocal(textureSize);
+    // Instance data is small enough to size each new segment for the sprites still queued, rather
+    // than always reserving room for the largest instanced batch.
+    auto segmentCapacity = [&]() noexcept
+    {
+        return mInstanced
+            ? std::min(std::max(queuedCount, MinBatchSize), mMaxBatchSize)
+            : mMaxBatchSize;
+    };
 
     while (count > 0)
     {
@@ -839,7 +1501,12 @@ void SpriteBatch::Impl::RenderBatch(D3D12_GPU_DESCRIPTOR_HANDLE texture, XMVECTO
         size_t batchSize = count;
 
         // How many sprites does the D3D vertex buffer have room for?
-        const size_t remainingSpace = MaxBatchSize - mSpriteCount;
+        if (mSpriteCount == 0)
+        {
+            mVertexSegmentCapacity = segmentCapacity();
+        }
+
+        const size_t remainingSpace = mVertexSegmentCapacity - mSpriteCount;
 
         if (batchSize > remainingSpace)
         {
@@ -847,8 +1514,9 @@ void SpriteBatch::Impl::RenderBatch(D3D12_GPU_DESCRIPTOR_HANDLE texture, XMVECTO
             {
                 // If we are out of room, or about to submit an excessively small batch, wrap back to the start of the vertex buffer.
                 mSpriteCount = 0;
+                mVertexSegmentCapacity = segmentCapacity();
 
-                batchSize = std::min(count, MaxBatchSize);
+                batchSize = std::min(count, mVertexSegmentCapacity);
             }
             else
             {
@@ -857,42 +1525,223 @@ void SpriteBatch::Impl::RenderBatch(D3D12_GPU_DESCRIPTOR_HANDLE texture, XMVECTO
             }
         }
 
-        // Allocate a new page of vertex memory if we're starting the batch
+        // Allocate a new page of vertex memory if we're starting the batch. Earlier pages are
+        // kept until their vertices have been written.
         if (mSpriteCount == 0)
         {
-            mVertexSegment = GraphicsMemory::Get(mDeviceResources->mDevice).Allocate(mVertexPageSize, 16, GraphicsMemory::TAG_SPRITES);
+            if (mVertexSegment)
+            {
+                mRetainedSegments.emplace_back(std::move(mVertexSegment));
+            }
+
+            mVertexSegment = GraphicsMemory::Get(mDeviceResources->mDevice).Allocate(mVertexSegmentCapacity * spriteStride, 16, GraphicsMemory::TAG_SPRITES);
         }
 
-        auto vertices = static_cast<VertexPositionColorTexture*>(mVertexSegment.Memory()) + mSpriteCount * VerticesPerSprite;
+        SpriteDraw draw;
+        draw.texture = texture;
+        XMStoreFloat2(&draw.textureSize, textureSize);
+        draw.sprites = sprites;
+        draw.count = batchSize;
+        draw.memory = static_cast<uint8_t*>(mVertexSegment.Memory()) + mSpriteCount * spriteStride;
+        draw.gpuAddress = mVertexSegment.GpuAddress() + (UINT64(mSpriteCount) * UINT64(spriteStride));
+
+        mDraws.push_back(draw);
+
+        // Advance the buffer position.
+        mSpriteCount += batchSize;
+
+        sprites += batchSize;
+        count -= batchSize;
+        queuedCount -= batchSize;
+    }
+}
+
+
+// Generates vertex data for part of a draw call.
+void SpriteBatch::Impl::GenerateVertices(SpriteDraw const& draw, size_t first, size_t count) const noexcept
+{
+    assert(first + count <= draw.count);
+
+    const XMVECTOR textureSize = XMLoadFloat2(&draw.textureSize);
+    const XMVECTOR inverseTextureSize = XMVectorReciprocal(textureSize);
+
+    SpriteInfo const* const* sprites = draw.sprites + first;
+
+    if (mInstanced)
+    {
+        auto instances = static_cast<SpriteInstance*>(draw.memory) + first;
+
+        // Generate one record per sprite.
+        for (size_t i = 0; i < count; i++)
+        {
+            RenderSpriteInstance(sprites[i], &instances[i], textureSize, inverseTextureSize);
+        }
+
+        return;
+    }
+
+    auto vertices = static_cast<VertexPositionColorTexture*>(draw.memory) + first * VerticesPerSprite;
+
+    size_t groupedCount = count;
+
+#ifdef DIRECTX_TOOLKIT_BENCHMARK_HOOKS
+    if (s_scalarVertices.load(std::memory_order_relaxed))
+    {
+        groupedCount = 0;
+    }
+#endif
+
+    // Generate sprite vertex data, four sprites at a time with any remainder one by one.
+    size_t i = 0;
+    for (; i + SpritesPerGroup <= groupedCount; i += SpritesPerGroup)
+    {
+        RenderSpriteGroup(&sprites[i], vertices, textureSize, inverseTextureSize);
+
+        vertices += VerticesPerSprite * SpritesPerGroup;
+    }
+
+    for (; i < count; i++)
+    {
+        RenderSprite(sprites[i], vertices, textureSize, inverseTextureSize);
+
+        vertices += VerticesPerSprite;
+    }
+}
+
+
+// Generates vertex data for all queued draw calls. Large batches are split into chunks
+// which worker threads and the calling thread take in turn.
+void SpriteBatch::Impl::GenerateQueuedVertices()
+{
+    size_t total = 0;
+    for (auto const& draw : mDraws)
+    {
+        total += draw.count;
+    }
+
+    if (total < ParallelVertexThreshold)
+    {
+        for (auto const& draw : mDraws)
+        {
+            GenerateVertices(draw, 0, draw.count);
+        }
+
+        return;
+    }
+
+    mVertexJobs.clear();
+
+    for (size_t j = 0; j < mDraws.size(); j++)
+    {
+        for (size_t first = 0; first < mDraws[j].count; first += ParallelVertexChunkSize)
+        {
+            mVertexJobs.push_back({ j, first, std::min(ParallelVertexChunkSize, mDraws[j].count - first) });
+        }
+    }
+
+    // The work runs on the process thread pool, so no threads are created per flush.
+    if (!mVertexWork)
+    {
+        mVertexWork.reset(CreateThreadpoolWork(VertexWorkCallback, this, nullptr));
+        if (!mVertexWork)
+            throw std::system_error(std::error_code(static_cast<int>(GetLastError()), std::system_category()), "CreateThreadpoolWork");
+    }
+
+    mNextVertexJob.store(0);
+
+    // The calling thread takes jobs too, and helpers that start late find nothing left to do.
+    const size_t threadCount = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), mVertexJobs.size());
+
+    for (size_t j = 1; j < threadCount; j++)
+    {
+        SubmitThreadpoolWork(mVertexWork.get());
+    }
+
+    RunVertexJobs();
+
+    WaitForThreadpoolWorkCallbacks(mVertexWork.get(), FALSE);
+}
+
+
+// Generates vertices for queued jobs until none are left.
+void SpriteBatch::Impl::RunVertexJobs() noexcept
+{
+    for (;;)
+    {
+        const size_t j = mNextVertexJob.fetch_add(1);
+        if (j >= mVertexJobs.size())
+            break;
+
+        auto const& job = mVertexJobs[j];
+        GenerateVertices(mDraws[job.draw], job.first, job.count);
+    }
+}
+
+
+// Thread pool callback which helps with the vertex jobs of a large flush.
+void CALLBACK SpriteBatch::Impl::VertexWorkCallback(PTP_CALLBACK_INSTANCE, PVOID context, PTP_WORK) noexcept
+{
+    static_cast<SpriteBatch::Impl*>(context)->RunVertexJobs();
+}
+
+
+// Records the queued draw calls into the command list.
+void SpriteBatch::Impl::SubmitDraws()
+{
+    RecordDraws(mDraws);
+
+    mDraws.clear();
+    mRetainedSegments.clear();
+}
+
+
+// Records draw calls whose vertices have been generated into the command list.
+void SpriteBatch::Impl::RecordDraws(std::vector<SpriteDraw> const& draws)
+{
+    auto commandList = mCommandList.Get();
+
+    D3D12_GPU_DESCRIPTOR_HANDLE boundTexture = {};
 
-        // Generate sprite vertex data.
-        for (size_t i = 0; i < batchSize; i++)
+    for (auto const& draw : draws)
+    {
+        if (draw.texture != boundTexture)
         {
-            assert(i < count);
-            _Analysis_assume_(i < count);
-            RenderSprite(sprites[i], vertices, textureSize, inverseTextureSize);
+            // Draw using the specified texture.
+            // **NOTE** If D3D asserts or crashes here, you probably need to call commandList->SetDescriptorHeaps() with the required descriptor heap(s)
+            commandList->SetGraphicsRootDescriptorTable(RootParameterIndex::TextureSRV, draw.texture);
+
+            if (mSampler.ptr)
+            {
+                commandList->SetGraphicsRootDescriptorTable(RootParameterIndex::TextureSampler, mSampler);
+            }
 
-            vertices += VerticesPerSprite;
+            boundTexture = draw.texture;
         }
 
         // Set the vertex buffer view
         D3D12_VERTEX_BUFFER_VIEW vbv;
-        constexpr size_t spriteVertexTotalSize = sizeof(VertexPositionColorTexture) * VerticesPerSprite;
-        vbv.BufferLocation = mVertexSegment.GpuAddress() + (UINT64(mSpriteCount) * UINT64(spriteVertexTotalSize));
-        vbv.StrideInBytes = sizeof(VertexPositionColorTexture);
-        vbv.SizeInBytes = static_cast<UINT>(batchSize * spriteVertexTotalSize);
-        commandList->IASetVertexBuffers(0, 1, &vbv);
+        vbv.BufferLocation = draw.gpuAddress;
 
-        // Ok lads, the time has come for us draw ourselves some sprites!
-        const UINT indexCount = static_cast<UINT>(batchSize * IndicesPerSprite);
+        if (mInstanced)
+        {
+            vbv.StrideInBytes = sizeof(SpriteInstance);
+            vbv.SizeInBytes = static_cast<UINT>(draw.count * sizeof(SpriteInstance));
+            commandList->IASetVertexBuffers(0, 1, &vbv);
 
-        commandList->DrawIndexedInstanced(indexCount, 1, 0, 0, 0);
+            commandList->DrawIndexedInstanced(static_cast<UINT>(IndicesPerSprite), static_cast<UINT>(draw.count), 0, 0, 0);
+        }
+        else
+        {
+            constexpr size_t spriteVertexTotalSize = sizeof(VertexPositionColorTexture) * VerticesPerSprite;
+            vbv.StrideInBytes = sizeof(VertexPositionColorTexture);
+            vbv.SizeInBytes = static_cast<UINT>(draw.count * spriteVertexTotalSize);
+            commandList->IASetVertexBuffers(0, 1, &vbv);
 
-        // Advance the buffer position.
-        mSpriteCount += batchSize;
+            // Ok lads, the time has come for us draw ourselves some sprites!
+            const UINT indexCount = static_cast<UINT>(draw.count * IndicesPerSprite);
 
-        sprites += batchSize;
-        count -= batchSize;
+            commandList->DrawIndexedInstanced(indexCount, 1, 0, 0, 0);
+        }
     }
 }
 
@@ -1009,6 +1858,186 @@ void XM_CALLCONV SpriteBatch::Impl::RenderSprite(SpriteInfo const* sprite, Verte
 }
 
 
+// Generates vertex data for four sprites at once. The sprite parameters are transposed so that
+// each XMVECTOR holds one component for all four sprites, then the same math as RenderSprite is
+// applied to all of them together.
+_Use_decl_annotations_
+void XM_CALLCONV SpriteBatch::Impl::RenderSpriteGroup(SpriteInfo const* const* sprites, VertexPositionColorTexture* vertices, FXMVECTOR textureSize, FXMVECTOR inverseTextureSize) noexcept
+{
+    static_assert(SpritesPerGroup == 4, "Sprite groups are transposed as 4x4 matrices");
+
+    // Load sprite parameters, one row per sprite, and transpose to one row per component.
+    const XMMATRIX source = XMMatrixTranspose(XMMATRIX(
+        XMLoadFloat4A(&sprites[0]->source),
+        XMLoadFloat4A(&sprites[1]->source),
+        XMLoadFloat4A(&sprites[2]->source),
+        XMLoadFloat4A(&sprites[3]->source)));
+
+    const XMMATRIX destination = XMMatrixTranspose(XMMATRIX(
+        XMLoadFloat4A(&sprites[0]->destination),
+        XMLoadFloat4A(&sprites[1]->destination),
+        XMLoadFloat4A(&sprites[2]->destination),
+        XMLoadFloat4A(&sprites[3]->destination)));
+
+    const XMMATRIX originRotationDepth = XMMatrixTranspose(XMMATRIX(
+        XMLoadFloat4A(&sprites[0]->originRotationDepth),
+        XMLoadFloat4A(&sprites[1]->originRotationDepth),
+        XMLoadFloat4A(&sprites[2]->originRotationDepth),
+        XMLoadFloat4A(&sprites[3]->originRotationDepth)));
+
+    // Per-sprite flags become lane masks.
+    const auto flagMask = [sprites](unsigned int flag) noexcept -> XMVECTOR
+    {
+        return XMVectorSelectControl(
+            (sprites[0]->flags & flag) ? 1u : 0u,
+            (sprites[1]->flags & flag) ? 1u : 0u,
+            (sprites[2]->flags & flag) ? 1u : 0u,
+            (sprites[3]->flags & flag) ? 1u : 0u);
+    };
+
+    const XMVECTOR sourceInTexels = flagMask(SpriteInfo::SourceInTexels);
+    const XMVECTOR destSizeInPixels = flagMask(SpriteInfo::DestSizeInPixels);
+    const XMVECTOR flipHorizontally = flagMask(SpriteEffects_FlipHorizontally);
+    const XMVECTOR flipVertically = flagMask(SpriteEffects_FlipVertically);
+
+    const XMVECTOR textureWidth = XMVectorSplatX(textureSize);
+    const XMVECTOR textureHeight = XMVectorSplatY(textureSize);
+    const XMVECTOR inverseTextureWidth = XMVectorSplatX(inverseTextureSize);
+    const XMVECTOR inverseTextureHeight = XMVectorSplatY(inverseTextureSize);
+
+    XMVECTOR sourceX = source.r[0];
+    XMVECTOR sourceY = source.r[1];
+    XMVECTOR sourceWidth = source.r[2];
+    XMVECTOR sourceHeight = source.r[3];
+
+    const XMVECTOR destinationX = destination.r[0];
+    const XMVECTOR destinationY = destination.r[1];
+    XMVECTOR destinationWidth = destination.r[2];
+    XMVECTOR destinationHeight = destination.r[3];
+
+    // Scale the origin offset by source size, taking care to avoid overflow if the source region is zero.
+    const XMVECTOR nonZeroSourceWidth = XMVectorSelect(sourceWidth, g_XMEpsilon, XMVectorEqual(sourceWidth, XMVectorZero()));
+    const XMVECTOR nonZeroSourceHeight = XMVectorSelect(sourceHeight, g_XMEpsilon, XMVectorEqual(sourceHeight, XMVectorZero()));
+
+    XMVECTOR originX = XMVectorDivide(originRotationDepth.r[0], nonZeroSourceWidth);
+    XMVECTOR originY = XMVectorDivide(originRotationDepth.r[1], nonZeroSourceHeight);
+
+    // Convert the source region from texels to mod-1 texture coordinate format.
+    sourceX = XMVectorSelect(sourceX, XMVectorMultiply(sourceX, inverseTextureWidth), sourceInTexels);
+    sourceY = XMVectorSelect(sourceY, XMVectorMultiply(sourceY, inverseTextureHeight), sourceInTexels);
+    sourceWidth = XMVectorSelect(sourceWidth, XMVectorMultiply(sourceWidth, inverseTextureWidth), sourceInTexels);
+    sourceHeight = XMVectorSelect(sourceHeight, XMVectorMultiply(sourceHeight, inverseTextureHeight), sourceInTexels);
+
+    originX = XMVectorSelect(XMVectorMultiply(originX, inverseTextureWidth), originX, sourceInTexels);
+    originY = XMVectorSelect(XMVectorMultiply(originY, inverseTextureHeight), originY, sourceInTexels);
+
+    // If the destination size is relative to the source region, convert it to pixels.
+    destinationWidth = XMVectorSelect(XMVectorMultiply(destinationWidth, textureWidth), destinationWidth, destSizeInPixels);
+    destinationHeight = XMVectorSelect(XMVectorMultiply(destinationHeight, textureHeight), destinationHeight, destSizeInPixels);
+
+    // Rotation for all four sprites at once.
+    XMVECTOR sin, cos;
+    XMVectorSinCos(&sin, &cos, originRotationDepth.r[2]);
+
+    const XMVECTOR depth = originRotationDepth.r[3];
+
+    // Generate the four output vertices of each sprite.
+    for (size_t i = 0; i < VerticesPerSprite; i++)
+    {
+        const XMVECTOR cornerX = (i & 1) ? g_XMOne : g_XMZero;
+        const XMVECTOR cornerY = (i & 2) ? g_XMOne : g_XMZero;
+
+        // Calculate position and apply the 2x2 rotation matrix.
+        const XMVECTOR offsetX = XMVectorMultiply(XMVectorSubtract(cornerX, originX), destinationWidth);
+        const XMVECTOR offsetY = XMVectorMultiply(XMVectorSubtract(cornerY, originY), destinationHeight);
+
+        const XMVECTOR positionX = XMVectorNegativeMultiplySubtract(offsetY, sin, XMVectorMultiplyAdd(offsetX, cos, destinationX));
+        const XMVECTOR positionY = XMVectorMultiplyAdd(offsetY, cos, XMVectorMultiplyAdd(offsetX, sin, destinationY));
+
+        // Mirrored sprites take their texture coordinates from the opposite corner.
+        const XMVECTOR textureCornerX = XMVectorSelect(cornerX, XMVectorSubtract(g_XMOne, cornerX), flipHorizontally);
+        const XMVECTOR textureCornerY = XMVectorSelect(cornerY, XMVectorSubtract(g_XMOne, cornerY), flipVertically);
+
+        const XMVECTOR textureCoordinateX = XMVectorMultiplyAdd(textureCornerX, sourceWidth, sourceX);
+        const XMVECTOR textureCoordinateY = XMVectorMultiplyAdd(textureCornerY, sourceHeight, sourceY);
+
+        // Transpose back to one row per sprite.
+        const XMMATRIX positions = XMMatrixTranspose(XMMATRIX(positionX, positionY, depth, g_XMZero));
+        const XMMATRIX textureCoordinates = XMMatrixTranspose(XMMATRIX(textureCoordinateX, textureCoordinateY, g_XMZero, g_XMZero));
+
+        for (size_t j = 0; j < SpritesPerGroup; j++)
+        {
+            auto& vertex = vertices[j * VerticesPerSprite + i];
+
+            // As in RenderSprite, the fourth position component is overwritten by the color.
+            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&vertex.position), positions.r[j]);
+            XMStoreFloat4(&vertex.color, XMLoadFloat4A(&sprites[j]->color));
+            XMStoreFloat2(&vertex.textureCoordinate, textureCoordinates.r[j]);
+        }
+    }
+}
+
+
+// Generates the instance record for drawing a single sprite, with the same math as RenderSprite
+// but leaving the corner expansion to the vertex shader.
+_Use_decl_annotations_
+void XM_CALLCONV SpriteBatch::Impl::RenderSpriteInstance(SpriteInfo const* sprite, SpriteInstance* instance, FXMVECTOR textureSize, FXMVECTOR inverseTextureSize) noexcept
+{
+    // Load sprite parameters into SIMD registers.
+    XMVECTOR source = XMLoadFloat4A(&sprite->source);
+    const XMVECTOR destination = XMLoadFloat4A(&sprite->destination);
+    const XMVECTOR originRotationDepth = XMLoadFloat4A(&sprite->originRotationDepth);
+
+    const unsigned int flags = sprite->flags;
+
+    // Extract the source and destination sizes into separate vectors.
+    XMVECTOR sourceSize = XMVectorSwizzle<2, 3, 2, 3>(source);
+    XMVECTOR destinationSize = XMVectorSwizzle<2, 3, 2, 3>(destination);
+
+    // Scale the origin offset by source size, taking care to avoid overflow if the source region is zero.
+    const XMVECTOR isZeroMask = XMVectorEqual(sourceSize, XMVectorZero());
+    const XMVECTOR nonZeroSourceSize = XMVectorSelect(sourceSize, g_XMEpsilon, isZeroMask);
+
+    XMVECTOR origin = XMVectorDivide(originRotationDepth, nonZeroSourceSize);
+
+    // Convert the source region from texels to mod-1 texture coordinate format.
+    if (flags & SpriteInfo::SourceInTexels)
+    {
+        source = XMVectorMultiply(source, inverseTextureSize);
+        sourceSize = XMVectorMultiply(sourceSize, inverseTextureSize);
+    }
+    else
+    {
+        origin = XMVectorMultiply(origin, inverseTextureSize);
+    }
+
+    // If the destination size is relative to the source region, convert it to pixels.
+    if (!(flags & SpriteInfo::DestSizeInPixels))
+    {
+        destinationSize = XMVectorMultiply(destinationSize, textureSize);
+    }
+
+    // Mirroring starts the texture coordinates from the opposite edge and walks them backwards.
+    static const XMVECTORU32 mirrorMasks[4] =
+    {
+        { { { 0, 0, 0, 0 } } },
+        { { { 0xFFFFFFFF, 0, 0, 0 } } },
+        { { { 0, 0xFFFFFFFF, 0, 0 } } },
+        { { { 0xFFFFFFFF, 0xFFFFFFFF, 0, 0 } } },
+    };
+
+    const XMVECTOR mirror = mirrorMasks[flags & 3u];
+
+    source = XMVectorSelect(source, XMVectorAdd(source, sourceSize), mirror);
+    sourceSize = XMVectorSelect(sourceSize, XMVectorNegate(sourceSize), mirror);
+
+    XMStoreFloat4(&instance->source, XMVectorPermute<0, 1, 4, 5>(source, sourceSize));
+    XMStoreFloat4(&instance->destination, XMVectorPermute<0, 1, 4, 5>(destination, destinationSize));
+    XMStoreFloat4(&instance->originRotationDepth, XMVectorPermute<0, 1, 6, 7>(origin, originRotationDepth));
+    XMStoreFloat4(&instance->color, XMLoadFloat4A(&sprite->color));
+}
+
+
 // Generates a viewport transform matrix for rendering sprites using x-right y-down screen pixel coordinates.
 XMMATRIX SpriteBatch::Impl::GetViewportTransform(_In_ DXGI_MODE_ROTATION rotation)
 {
@@ -1078,6 +2107,37 @@ SpriteBatch& SpriteBatch::operator= (SpriteBatch&&) noexcept = default;
 SpriteBatch::~SpriteBatch() = default;
 
 
+//--------------------------------------------------------------------------------------
+// SpriteBatch::Retained
+//--------------------------------------------------------------------------------------
+
+SpriteBatch::Retained::Retained() noexcept(false) :
+    pImpl(std::make_unique<Impl>())
+{}
+
+SpriteBatch::Retained::Retained(Retained&&) noexcept = default;
+SpriteBatch::Retained& SpriteBatch::Retained::operator= (Retained&&) noexcept = default;
+SpriteBatch::Retained::~Retained() = default;
+
+
+size_t SpriteBatch::Retained::SpriteCount() const noexcept
+{
+    return pImpl ? pImpl->sprites.size() : 0;
+}
+
+
+void SpriteBatch::Retained::Reset() noexcept
+{
+    if (pImpl)
+    {
+        pImpl->sprites.clear();
+        pImpl->vertices.clear();
+        pImpl->draws.clear();
+        pImpl->vertexBuffer.Reset();
+    }
+}
+
+
 // Begin using static sampler
 _Use_decl_annotations_
 void XM_CALLCONV SpriteBatch::Begin(
@@ -1157,6 +2217,79 @@ void SpriteBatch::End()
 }
 
 
+// Begin capturing a retained batch
+void SpriteBatch::BeginRetained(Retained& retained, SpriteSortMode sortMode)
+{
+    if (!retained.pImpl)
+        throw std::invalid_argument("Retained sprites have been moved from");
+
+    pImpl->BeginRetained(retained.pImpl.get(), 0, 0, sortMode, false);
+}
+
+
+// Begin replacing the end of a retained batch
+void SpriteBatch::BeginRetainedUpdate(Retained& retained, size_t firstSprite)
+{
+    if (!retained.pImpl)
+        throw std::invalid_argument("Retained sprites have been moved from");
+
+    const size_t size = retained.pImpl->sprites.size();
+    const size_t spriteCount = (firstSprite < size) ? size - firstSprite : 0;
+
+    pImpl->BeginRetained(retained.pImpl.get(), firstSprite, spriteCount, SpriteSortMode_Deferred, true);
+}
+
+
+// Begin replacing a range of a retained batch
+void SpriteBatch::BeginRetainedUpdate(Retained& retained, size_t firstSprite, size_t spriteCount)
+{
+    if (!retained.pImpl)
+        throw std::invalid_argument("Retained sprites have been moved from");
+
+    pImpl->BeginRetained(retained.pImpl.get(), firstSprite, spriteCount, SpriteSortMode_Deferred, true);
+}
+
+
+// Draw a retained batch using static sampler
+_Use_decl_annotations_
+void XM_CALLCONV SpriteBatch::DrawRetained(
+    ID3D12GraphicsCommandList* commandList,
+    Retained const& retained,
+    FXMMATRIX transformMatrix)
+{
+    if (!retained.pImpl)
+        throw std::invalid_argument("Retained sprites have been moved from");
+
+    pImpl->DrawRetained(commandList, *retained.pImpl, transformMatrix);
+}
+
+
+// Draw a retained batch with heap-based sampler
+_Use_decl_annotations_
+void XM_CALLCONV SpriteBatch::DrawRetained(
+    ID3D12GraphicsCommandList* commandList,
+    D3D12_GPU_DESCRIPTOR_HANDLE sampler,
+    Retained const& retained,
+    FXMMATRIX transformMatrix)
+{
+    if (!sampler.ptr)
+        throw std::invalid_argument("Invalid heap-based sampler for DrawRetained");
+
+    if (!retained.pImpl)
+        throw std::invalid_argument("Retained sprites have been moved from");
+
+    if (!pImpl->mSampler.ptr)
+    {
+        DebugTrace("ERROR: sampler version of DrawRetained requires SpriteBatch was created with a heap-based sampler\n");
+        throw std::runtime_error("SpriteBatch::DrawRetained");
+    }
+
+    pImpl->mSampler = sampler;
+
+    pImpl->DrawRetained(commandList, *retained.pImpl, transformMatrix);
+}
+
+
 void XM_CALLCONV SpriteBatch::Draw(D3D12_GPU_DESCRIPTOR_HANDLE texture,
     XMUINT2 const& textureSize,
     XMFLOAT2 const& position,